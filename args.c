@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdnoreturn.h>
+#include <string.h>
 #include <syslog.h>
 
 #include <sys/stat.h>
@@ -37,6 +38,15 @@ bool file_exists(const char *path)
     return true;
 }
 
+/* return the value of a "--name=value" argument, or NULL if arg is not that
+ * option */
+static char *option_value(char *arg, const char *name)
+{
+    size_t len = strlen(name);
+    if(strncmp(arg, name, len) != 0 || arg[len] != '=') return NULL;
+    return arg + len + 1;
+}
+
 void args_free(args_t *args)
 {
     if(!args) return;
@@ -53,6 +63,47 @@ args_t *args_create(int argc, char **argv)
     }
 
     int cur = 1;
+    for(; cur < argc && strncmp(argv[cur], "--", 2) == 0; cur++) {
+        char *value = NULL;
+        if((value = option_value(argv[cur], "--timing"))) {
+            args->timing_path = value;
+        } else if((value = option_value(argv[cur], "--mirrors"))) {
+            if(!file_exists(value)) {
+                args_free(args);
+                return NULL;
+            }
+            args->mirrors_path = value;
+        } else if((value = option_value(argv[cur], "--policy"))) {
+            if(!file_exists(value)) {
+                args_free(args);
+                return NULL;
+            }
+            args->policy_path = value;
+        } else if((value = option_value(argv[cur], "--refresh"))) {
+            /* written once the streams are fetched, so not there yet */
+            args->refresh_path = value;
+        } else if((value = option_value(argv[cur], "--max-size"))) {
+            char *end = NULL;
+            long long max_size = strtoll(value, &end, 10);
+            if(!*value || *end || max_size <= 0) {
+                fprintf(stderr, "invalid size %s\n", value);
+                args_free(args);
+                return NULL;
+            }
+            args->max_size = max_size;
+        } else if(strcmp(argv[cur], "--console-font") == 0) {
+            args->console_font = true;
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[cur]);
+            args_free(args);
+            return NULL;
+        }
+    }
+
+    if(cur >= argc) {
+        args_free(args);
+        return NULL;
+    }
     args->outfile = argv[cur++];
 
     args->num_infiles = argc - cur;
@@ -19,9 +19,18 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
 typedef struct _args_t
 {
     char *outfile;
+    char *timing_path; /* optional, from --timing=<path> */
+    char *mirrors_path; /* optional, from --mirrors=<path> */
+    char *policy_path; /* optional, from --policy=<path> */
+    bool console_font; /* from --console-font */
+    char *refresh_path; /* optional, from --refresh=<marker> */
+    int64_t max_size; /* from --max-size=<bytes>, 0 for no limit */
     int  num_infiles;
     char **infiles;
 } args_t;
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "catalog.h"
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+
+#include "json.h"
+
+catalog_t *catalog_create(int num_inputs, char **paths)
+{
+    catalog_t *ret = calloc(sizeof(catalog_t), 1);
+    if(!ret) return NULL;
+
+    ret->inputs = calloc(sizeof(catalog_input_t), num_inputs);
+    if(!ret->inputs) {
+        free(ret);
+        return NULL;
+    }
+    ret->num_inputs = num_inputs;
+    for(int i = 0; i < num_inputs; i++) {
+        ret->inputs[i].path = paths[i];
+    }
+    return ret;
+}
+
+void entries_free(catalog_entry_t *entries, int len)
+{
+    for(int i = 0; i < len; i++) {
+        free(entries[i].arch);
+        free(entries[i].name);
+        free(entries[i].body);
+    }
+    free(entries);
+}
+
+void catalog_free(catalog_t *catalog)
+{
+    if(!catalog) return;
+    for(int i = 0; i < catalog->num_inputs; i++) {
+        entries_free(catalog->inputs[i].entries, catalog->inputs[i].len);
+    }
+    free(catalog->inputs);
+    free(catalog);
+}
+
+bool input_matches(catalog_input_t *input, struct stat *st)
+{
+    return !input->missing
+        && input->dev == st->st_dev
+        && input->ino == st->st_ino
+        && input->size == st->st_size
+        && input->mtime.tv_sec == st->st_mtim.tv_sec
+        && input->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+bool catalog_changed(catalog_t *catalog)
+{
+    for(int i = 0; i < catalog->num_inputs; i++) {
+        struct stat st;
+        if(stat(catalog->inputs[i].path, &st) == -1) {
+            if(!catalog->inputs[i].missing) return true;
+        } else if(!input_matches(&catalog->inputs[i], &st)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* append the pruned stream for arch, or every arch if NULL */
+bool add_entry(catalog_entry_t **entries, int *len, json_object *root,
+               const char *arch, const char *name)
+{
+    json_object *pruned = prune_stream(root, arch);
+    if(!pruned) return false;
+
+    bool ret = false;
+    const char *body = json_object_to_json_string_ext(pruned,
+            JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE);
+    catalog_entry_t *grown = realloc(*entries,
+                                     sizeof(catalog_entry_t) * (*len + 1));
+    if(body && grown) {
+        *entries = grown;
+        catalog_entry_t *entry = &grown[*len];
+        entry->arch = arch ? strdup(arch) : NULL;
+        entry->name = strdup(name);
+        entry->body = strdup(body);
+        entry->len = strlen(body);
+        (*len)++;
+        ret = entry->name && entry->body && (!arch || entry->arch);
+    } else if(grown) {
+        *entries = grown;
+    }
+
+    json_object_put(pruned);
+    return ret;
+}
+
+/* one entry for every arch, then one for each arch offered */
+bool add_stream(catalog_entry_t **entries, int *len, json_object *root,
+                const char *name)
+{
+    criteria_t *criteria = criteria_for_content_id(
+            str(get(root, "content_id")));
+    json_object *products = get(root, "products");
+    if(!criteria || !products) return false;
+
+    if(!add_entry(entries, len, root, NULL, name)) return false;
+    int first = *len;
+
+    json_object_object_foreach(products, key, product) {
+        (void)key;
+        if(!product_is_viable(product, criteria, NULL)) continue;
+        const char *arch = str(get(product, "arch"));
+        if(!arch) continue;
+
+        bool seen = false;
+        for(int i = first; i < *len && !seen; i++) {
+            seen = eq((*entries)[i].arch, arch);
+        }
+        if(seen) continue;
+        if(!add_entry(entries, len, root, arch, name)) return false;
+    }
+    return true;
+}
+
+/* parse the input again, replacing its entries if it is a stream the menu
+ * reads; its stat is recorded either way, so a bad input isn't parsed again
+ * until it changes */
+bool input_rebuild(catalog_input_t *input)
+{
+    /* stat first, so a change while parsing is picked up next time */
+    struct stat st;
+    if(stat(input->path, &st) == -1) {
+        fprintf(stderr, "%s: %m\n", input->path);
+        input->missing = true;
+        return false;
+    }
+    input->missing = false;
+    input->dev = st.st_dev;
+    input->ino = st.st_ino;
+    input->size = st.st_size;
+    input->mtime = st.st_mtim;
+
+    catalog_entry_t *entries = NULL;
+    int len = 0;
+    json_object *root = stream_from_file(input->path);
+    char *copy = strdup(input->path);
+    bool ok = root && copy && add_stream(&entries, &len, root,
+                                         basename(copy));
+    free(copy);
+    json_object_put(root);
+    if(!ok) {
+        fprintf(stderr, "%s: not a stream the menu reads\n", input->path);
+        entries_free(entries, len);
+        return false;
+    }
+
+    entries_free(input->entries, input->len);
+    input->entries = entries;
+    input->len = len;
+    return true;
+}
+
+bool catalog_rebuild(catalog_t *catalog)
+{
+    bool ok = true;
+    catalog->len = 0;
+    for(int i = 0; i < catalog->num_inputs; i++) {
+        if(!input_rebuild(&catalog->inputs[i])) ok = false;
+        catalog->len += catalog->inputs[i].len;
+    }
+    return ok;
+}
+
+const catalog_entry_t *catalog_lookup(catalog_t *catalog, const char *arch,
+                                      const char *name)
+{
+    if(!name) return NULL;
+    for(int i = 0; i < catalog->num_inputs; i++) {
+        catalog_input_t *input = &catalog->inputs[i];
+        for(int j = 0; j < input->len; j++) {
+            catalog_entry_t *entry = &input->entries[j];
+            if(!eq(entry->name, name)) continue;
+            if(arch ? eq(entry->arch, arch) : !entry->arch) return entry;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <sys/types.h>
+
+/* A stream pruned for the menu, see prune_stream(), ready to send. */
+typedef struct _catalog_entry_t
+{
+    char *arch; /* NULL for the entry covering every arch */
+    char *name; /* file name of the input stream */
+    char *body; /* the pruned stream as compact JSON */
+    size_t len;
+} catalog_entry_t;
+
+/* What an input looked like when it was last parsed, and the entries from
+ * the last time that worked. */
+typedef struct _catalog_input_t
+{
+    const char *path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    bool missing; /* it couldn't be found */
+
+    int len;
+    catalog_entry_t *entries;
+} catalog_input_t;
+
+typedef struct _catalog_t
+{
+    int num_inputs;
+    catalog_input_t *inputs;
+
+    int len; /* entries over all the inputs */
+} catalog_t;
+
+catalog_t *catalog_create(int num_inputs, char **paths);
+void catalog_free(catalog_t *catalog);
+
+/* whether any input was replaced, modified or removed since the last build */
+bool catalog_changed(catalog_t *catalog);
+
+/* parse every input again and replace the entries of each that is read as a
+ * stream the menu knows; an input that isn't keeps the entries it had, false
+ * is returned, and catalog_changed() stays false until an input changes
+ * again */
+bool catalog_rebuild(catalog_t *catalog);
+
+/* the entry for the stream with this file name, pruned for arch, or for
+ * every arch if arch is NULL */
+const catalog_entry_t *catalog_lookup(catalog_t *catalog, const char *arch,
+                                      const char *name);
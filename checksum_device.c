@@ -0,0 +1,92 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checksum the first N bytes of a device, compare against the expected
+ * result and return pass / fail.
+ *
+ * usage: checksum-device filepath size_of_filepath expected_sum
+ */
+
+#include "common.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <strings.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <sys/param.h>
+
+#include "sha256.h"
+
+#define CHUNK_SIZE (4 * 1024 * 1024)
+
+noreturn void usage(char *prog)
+{
+    fprintf(stderr, "usage: %s <path> <size> <expected sha256>\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc != 4) usage(argv[0]);
+
+    char *end = NULL;
+    long long size = strtoll(argv[2], &end, 10);
+    if(*end || size < 0) usage(argv[0]);
+
+    int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+    if(fd == -1) {
+        perror(argv[1]);
+        return 1;
+    }
+    posix_fadvise(fd, 0, size, POSIX_FADV_SEQUENTIAL);
+
+    uint8_t *buf = malloc(CHUNK_SIZE);
+    if(!buf) {
+        fprintf(stderr, "alloc failure\n");
+        return 1;
+    }
+
+    sha256_t ctx;
+    sha256_init(&ctx);
+    for(long long done = 0; done < size; ) {
+        ssize_t rv = read(fd, buf, MIN(size - done, CHUNK_SIZE));
+        if(rv <= 0) {
+            fprintf(stderr, "%s: short read at %lld\n", argv[1], done);
+            return 1;
+        }
+        sha256_update(&ctx, buf, rv);
+        done += rv;
+    }
+    free(buf);
+    close(fd);
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    char actual[SHA256_DIGEST_SIZE * 2 + 1];
+    sha256_final(&ctx, digest);
+    sha256_hex(digest, actual);
+    syslog(LOG_DEBUG, "sha256 %s with %s", actual, sha256_kernel_name());
+
+    return strcasecmp(actual, argv[3]) == 0 ? 0 : 1;
+}
@@ -55,6 +55,10 @@ void iso_data_free(iso_data_t *iso_data)
     if(!iso_data) return;
     free(iso_data->label);
     free(iso_data->url);
+    free(iso_data->sha256sum);
+    free(iso_data->mirrors);
+    free(iso_data->version);
+    free(iso_data->os);
     free(iso_data);
 }
 
@@ -79,6 +83,7 @@ void choices_free(choices_t *choices)
     for(int i = 0; i < choices->len; i++) {
         iso_data_free(choices->values[i]);
     }
+    free(choices->values);
     free(choices);
 }
 
@@ -32,6 +32,9 @@ typedef struct _iso_data
     char *url;
     char *sha256sum;
     int64_t size;
+    char *mirrors; /* space separated alternate urls, or NULL */
+    char *version; /* release_title, for ordering */
+    char *os; /* for ordering by flavour */
 } iso_data_t;
 
 typedef struct _choices
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "dedupe.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "json.h"
+
+/* FNV-1a */
+unsigned int hash_bytes(unsigned int hash, const void *data, size_t len,
+                        bool fold_case)
+{
+    const unsigned char *p = data;
+    for(size_t i = 0; i < len; i++) {
+        unsigned char c = p[i];
+        if(fold_case && c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+#define HASH_INIT 2166136261u
+
+bool has_sum(const iso_data_t *data)
+{
+    return data->sha256sum && data->sha256sum[0];
+}
+
+/* the file name of the url */
+const char *url_name(const iso_data_t *data)
+{
+    const char *slash = data->url ? strrchr(data->url, '/') : NULL;
+    return slash ? slash + 1 : data->url ? data->url : "";
+}
+
+unsigned int hash_sum(const iso_data_t *data)
+{
+    return hash_bytes(HASH_INIT, data->sha256sum, strlen(data->sha256sum),
+                      true);
+}
+
+unsigned int hash_name(const iso_data_t *data)
+{
+    const char *name = url_name(data);
+    unsigned int hash = hash_bytes(HASH_INIT, name, strlen(name), false);
+    return hash_bytes(hash, &data->size, sizeof(data->size), false);
+}
+
+bool same_sum(const iso_data_t *a, const iso_data_t *b)
+{
+    return has_sum(a) && has_sum(b)
+        && strcasecmp(a->sha256sum, b->sha256sum) == 0;
+}
+
+bool same_name(const iso_data_t *a, const iso_data_t *b)
+{
+    return a->size == b->size && eq(url_name(a), url_name(b));
+}
+
+/* the slot holding a match for data, else the empty slot where it goes */
+int *probe(dedupe_t *dedupe, int *table, unsigned int hash,
+           const iso_data_t *data,
+           bool (*same)(const iso_data_t *, const iso_data_t *))
+{
+    for(unsigned int i = hash & dedupe->mask; ; i = (i + 1) & dedupe->mask) {
+        int *slot = &table[i];
+        if(!*slot) return slot;
+        if(same(dedupe->choices->values[*slot - 1], data)) return slot;
+    }
+}
+
+/* append url to the space separated mirrors, unless already there */
+void add_mirror(iso_data_t *data, const char *url)
+{
+    if(!url || eq(url, data->url)) return;
+
+    const char *cur = data->mirrors;
+    size_t len = strlen(url);
+    while(cur && *cur) {
+        if(strncmp(cur, url, len) == 0 && (cur[len] == ' ' || !cur[len]))
+            return;
+        cur = strchr(cur, ' ');
+        if(cur) cur++;
+    }
+
+    char *prev = data->mirrors;
+    char *mirrors = saprintf("%s%s%s", prev ? prev : "", prev ? " " : "", url);
+    if(!mirrors) return;
+    data->mirrors = mirrors;
+    free(prev);
+}
+
+/* fold dup into the choice kept, which takes the preferred url */
+void merge(dedupe_t *dedupe, iso_data_t *kept, iso_data_t *dup)
+{
+    if(policy_source_rank(dedupe->policy, dup->url)
+            < policy_source_rank(dedupe->policy, kept->url)) {
+        char *url = kept->url;
+        kept->url = dup->url;
+        dup->url = url;
+    }
+    add_mirror(kept, dup->url);
+
+    char *save = NULL;
+    for(char *url = dup->mirrors ? strtok_r(dup->mirrors, " ", &save) : NULL;
+            url; url = strtok_r(NULL, " ", &save)) {
+        add_mirror(kept, url);
+    }
+    if(!has_sum(kept) && has_sum(dup)) {
+        char *sum = kept->sha256sum;
+        kept->sha256sum = dup->sha256sum;
+        dup->sha256sum = sum;
+    }
+    iso_data_free(dup);
+}
+
+/* record choices->values[index] in the tables, where no match is yet */
+void index_choice(dedupe_t *dedupe, int index)
+{
+    iso_data_t *data = dedupe->choices->values[index];
+    if(has_sum(data)) {
+        int *slot = probe(dedupe, dedupe->by_sum, hash_sum(data), data,
+                          same_sum);
+        if(!*slot) *slot = index + 1;
+    }
+    int *slot = probe(dedupe, dedupe->by_name, hash_name(data), data,
+                      same_name);
+    if(!*slot) *slot = index + 1;
+}
+
+/* the choice that is the same image as data, or NULL */
+iso_data_t *find(dedupe_t *dedupe, iso_data_t *data)
+{
+    iso_data_t **values = dedupe->choices->values;
+    if(has_sum(data)) {
+        int *slot = probe(dedupe, dedupe->by_sum, hash_sum(data), data,
+                          same_sum);
+        if(*slot) return values[*slot - 1];
+    }
+
+    /* a name match only counts where a sum is missing */
+    int *slot = probe(dedupe, dedupe->by_name, hash_name(data), data,
+                      same_name);
+    if(*slot && (!has_sum(data) || !has_sum(values[*slot - 1])))
+        return values[*slot - 1];
+    return NULL;
+}
+
+dedupe_t *dedupe_create(choices_t *choices, const policy_t *policy)
+{
+    dedupe_t *ret = calloc(sizeof(dedupe_t), 1);
+    if(!ret) return NULL;
+
+    /* at most half full */
+    unsigned int size = 16;
+    while(size < 2 * (unsigned int)choices->capacity) size *= 2;
+    ret->mask = size - 1;
+    ret->by_sum = calloc(sizeof(int), size);
+    ret->by_name = calloc(sizeof(int), size);
+    if(!ret->by_sum || !ret->by_name) {
+        dedupe_free(ret);
+        return NULL;
+    }
+    ret->choices = choices;
+    ret->policy = policy;
+
+    for(int i = 0; i < choices->len; i++) {
+        index_choice(ret, i);
+    }
+    return ret;
+}
+
+void dedupe_free(dedupe_t *dedupe)
+{
+    if(!dedupe) return;
+    free(dedupe->by_sum);
+    free(dedupe->by_name);
+    free(dedupe);
+}
+
+bool dedupe_append(dedupe_t *dedupe, iso_data_t *data)
+{
+    iso_data_t *match = find(dedupe, data);
+    if(match) {
+        merge(dedupe, match, data);
+        return true;
+    }
+
+    if(!choices_append(dedupe->choices, data)) return false;
+    index_choice(dedupe, dedupe->choices->len - 1);
+    return true;
+}
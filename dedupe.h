@@ -0,0 +1,49 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "common.h"
+#include "policy.h"
+
+/* Collapses choices for the same image, as found when several streams
+ * overlap, such as a mirror's and upstream's.  Images are the same if their
+ * sha256 sums are, or failing a sum, if their file names and sizes are.
+ *
+ * The choices are indexed by both in open addressing hash tables, sized for
+ * the capacity of the choices, so each append is a constant time lookup. */
+typedef struct _dedupe_t
+{
+    choices_t *choices;
+    const policy_t *policy; /* for the preferred source, may be NULL */
+    unsigned int mask; /* table size - 1, the size being a power of two */
+    int *by_sum; /* index + 1 into choices->values, 0 for an empty slot */
+    int *by_name;
+} dedupe_t;
+
+dedupe_t *dedupe_create(choices_t *choices, const policy_t *policy);
+void dedupe_free(dedupe_t *dedupe);
+
+/* Add data to the choices, unless it is an image already there.  Then the
+ * url preferred by the policy is kept, the earlier one if neither is, and
+ * the other joins the mirrors of the choice.  Either way data is owned by the
+ * choices after a successful call; false means it couldn't be added. */
+bool dedupe_append(dedupe_t *dedupe, iso_data_t *data);
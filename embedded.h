@@ -0,0 +1,33 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Compiled into iso-chooser-menu by scripts/embed.py, see meson.build, so
+ * that neither has to be installed in the initramfs: the console font, and
+ * the terminfo entry of the terminal agetty starts the menu on. */
+#define EMBEDDED_TERM "linux-c"
+
+extern const uint8_t embedded_font[];
+extern const size_t embedded_font_len;
+extern const uint8_t embedded_terminfo[];
+extern const size_t embedded_terminfo_len;
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "font.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include <linux/kd.h>
+#include <sys/ioctl.h>
+
+#define PSF1_MAGIC "\x36\x04"
+#define PSF1_HEADER_SIZE 4
+#define PSF1_MODE512 0x01
+#define PSF1_MODEHASTAB 0x02
+#define PSF1_MODEHASSEQ 0x04
+#define PSF1_SEPARATOR 0xFFFF
+#define PSF1_STARTSEQ 0xFFFE
+
+#define PSF2_MAGIC "\x72\xb5\x4a\x86"
+#define PSF2_HEADER_SIZE 32
+#define PSF2_HAS_UNICODE_TABLE 0x01
+#define PSF2_SEPARATOR 0xFF
+#define PSF2_STARTSEQ 0xFE
+
+/* the console takes glyphs of up to this many rows, padded to it */
+#define CONSOLE_VPITCH 32
+
+static uint32_t le16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static bool add_unipair(font_t *font, int *capacity, uint32_t unicode,
+                        unsigned int glyph)
+{
+    if(unicode > 0xFFFF) return true;
+    if(font->num_unipairs == *capacity) {
+        int next = *capacity ? *capacity * 2 : 256;
+        font_unipair_t *unipairs = realloc(font->unipairs,
+                                           next * sizeof(font_unipair_t));
+        if(!unipairs) return false;
+        font->unipairs = unipairs;
+        *capacity = next;
+    }
+    font->unipairs[font->num_unipairs++] = (font_unipair_t){
+        .unicode = unicode,
+        .glyph = glyph,
+    };
+    return true;
+}
+
+/* PSF1 tables are little-endian UCS-2, per glyph ended by PSF1_SEPARATOR */
+static bool parse_psf1_table(font_t *font, const uint8_t *cur,
+                             const uint8_t *end)
+{
+    int capacity = 0;
+    for(unsigned int glyph = 0; glyph < font->charcount; glyph++) {
+        bool in_sequence = false;
+        for(;;) {
+            if(end - cur < 2) return false;
+            uint32_t value = le16(cur);
+            cur += 2;
+            if(value == PSF1_SEPARATOR) break;
+            if(value == PSF1_STARTSEQ) in_sequence = true;
+            if(in_sequence) continue;
+            if(!add_unipair(font, &capacity, value, glyph)) return false;
+        }
+    }
+    return true;
+}
+
+/* decode one UTF-8 character at *cur, 0 if it is not valid */
+static int utf8_decode(const uint8_t *cur, const uint8_t *end,
+                       uint32_t *value)
+{
+    int len = 0;
+    if(cur[0] < 0x80) len = 1, *value = cur[0];
+    else if((cur[0] & 0xE0) == 0xC0) len = 2, *value = cur[0] & 0x1F;
+    else if((cur[0] & 0xF0) == 0xE0) len = 3, *value = cur[0] & 0x0F;
+    else if((cur[0] & 0xF8) == 0xF0) len = 4, *value = cur[0] & 0x07;
+    else return 0;
+
+    if(end - cur < len) return 0;
+    for(int i = 1; i < len; i++) {
+        if((cur[i] & 0xC0) != 0x80) return 0;
+        *value = *value << 6 | (cur[i] & 0x3F);
+    }
+    return len;
+}
+
+/* PSF2 tables are UTF-8, per glyph ended by PSF2_SEPARATOR */
+static bool parse_psf2_table(font_t *font, const uint8_t *cur,
+                             const uint8_t *end)
+{
+    int capacity = 0;
+    for(unsigned int glyph = 0; glyph < font->charcount; glyph++) {
+        bool in_sequence = false;
+        for(;;) {
+            if(cur == end) return false;
+            if(*cur == PSF2_SEPARATOR) {
+                cur++;
+                break;
+            }
+            if(*cur == PSF2_STARTSEQ) in_sequence = true;
+            if(in_sequence) {
+                cur++;
+                continue;
+            }
+
+            uint32_t value = 0;
+            int len = utf8_decode(cur, end, &value);
+            if(!len) return false;
+            cur += len;
+            if(!add_unipair(font, &capacity, value, glyph)) return false;
+        }
+    }
+    return true;
+}
+
+font_t *font_parse(const uint8_t *data, size_t len)
+{
+    if(!data) return NULL;
+    font_t *font = calloc(1, sizeof(font_t));
+    if(!font) return NULL;
+
+    size_t header_size = 0;
+    bool has_table = false;
+    bool psf1 = false;
+    if(len >= PSF1_HEADER_SIZE && memcmp(data, PSF1_MAGIC, 2) == 0) {
+        psf1 = true;
+        header_size = PSF1_HEADER_SIZE;
+        font->width = 8;
+        font->height = data[3];
+        font->charcount = data[2] & PSF1_MODE512 ? 512 : 256;
+        font->charsize = data[3];
+        has_table = data[2] & (PSF1_MODEHASTAB | PSF1_MODEHASSEQ);
+    } else if(len >= PSF2_HEADER_SIZE && memcmp(data, PSF2_MAGIC, 4) == 0) {
+        header_size = le32(data + 8);
+        has_table = le32(data + 12) & PSF2_HAS_UNICODE_TABLE;
+        font->charcount = le32(data + 16);
+        font->charsize = le32(data + 20);
+        font->height = le32(data + 24);
+        font->width = le32(data + 28);
+    } else {
+        font_free(font);
+        return NULL;
+    }
+
+    /* as much as the console takes, which also keeps sizes from
+     * overflowing */
+    if(!font->width || font->width > 32 || !font->height
+            || font->height > CONSOLE_VPITCH
+            || !font->charcount || font->charcount > 512
+            || font->charsize != font->height * ((font->width + 7) / 8)
+            || header_size < (psf1 ? PSF1_HEADER_SIZE : PSF2_HEADER_SIZE)
+            || header_size > len
+            || (len - header_size) / font->charsize < font->charcount) {
+        font_free(font);
+        return NULL;
+    }
+    font->glyphs = data + header_size;
+
+    const uint8_t *table = font->glyphs + font->charcount * font->charsize;
+    bool ok = !has_table
+        || (psf1 ? parse_psf1_table(font, table, data + len)
+                 : parse_psf2_table(font, table, data + len));
+    if(!ok) {
+        font_free(font);
+        return NULL;
+    }
+    return font;
+}
+
+void font_free(font_t *font)
+{
+    if(!font) return;
+    free(font->unipairs);
+    free(font);
+}
+
+int font_glyph_for(const font_t *font, uint32_t unicode)
+{
+    if(!font) return -1;
+    for(int i = 0; i < font->num_unipairs; i++) {
+        if(font->unipairs[i].unicode == unicode) {
+            return font->unipairs[i].glyph;
+        }
+    }
+    return -1;
+}
+
+bool font_load_console(int fd, const font_t *font)
+{
+    if(!font) return false;
+
+    /* the console wants every glyph padded to CONSOLE_VPITCH rows */
+    size_t pitch = (font->width + 7) / 8;
+    size_t padded = CONSOLE_VPITCH * pitch;
+    uint8_t *data = calloc(font->charcount, padded);
+    if(!data) return false;
+    for(unsigned int i = 0; i < font->charcount; i++) {
+        memcpy(data + i * padded, font->glyphs + i * font->charsize,
+               font->charsize);
+    }
+
+    struct console_font_op op = {
+        .op = KD_FONT_OP_SET,
+        .width = font->width,
+        .height = font->height,
+        .charcount = font->charcount,
+        .data = data,
+    };
+    int rv = ioctl(fd, KDFONTOP, &op);
+    free(data);
+    if(rv == -1) {
+        syslog(LOG_DEBUG, "KDFONTOP failed: %m");
+        return false;
+    }
+    if(!font->num_unipairs) return true;
+
+    struct unimapinit init = {};
+    if(ioctl(fd, PIO_UNIMAPCLR, &init) == -1) {
+        syslog(LOG_DEBUG, "PIO_UNIMAPCLR failed: %m");
+        return false;
+    }
+
+    struct unipair *entries = calloc(font->num_unipairs,
+                                     sizeof(struct unipair));
+    if(!entries) return false;
+    for(int i = 0; i < font->num_unipairs; i++) {
+        entries[i].unicode = font->unipairs[i].unicode;
+        entries[i].fontpos = font->unipairs[i].glyph;
+    }
+    struct unimapdesc desc = {
+        .entry_ct = font->num_unipairs,
+        .entries = entries,
+    };
+    rv = ioctl(fd, PIO_UNIMAP, &desc);
+    free(entries);
+    if(rv == -1) {
+        syslog(LOG_DEBUG, "PIO_UNIMAP failed: %m");
+        return false;
+    }
+    return true;
+}
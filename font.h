@@ -0,0 +1,56 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A console font in PSF1 or PSF2 format, as setfont loads them.  Glyphs are
+ * kept as in the file, and the unicode table as the code points each glyph
+ * shows; sequences of combining characters are skipped, as are code points
+ * above U+FFFF, which the console can't map. */
+typedef struct _font_unipair_t
+{
+    uint16_t unicode;
+    uint16_t glyph;
+} font_unipair_t;
+
+typedef struct _font_t
+{
+    unsigned int width;
+    unsigned int height;
+    unsigned int charcount;
+    size_t charsize; /* bytes per glyph, height rows of (width + 7) / 8 */
+    const uint8_t *glyphs; /* points into the parsed data */
+    int num_unipairs;
+    font_unipair_t *unipairs;
+} font_t;
+
+/* NULL if data is not a font, or is truncated */
+font_t *font_parse(const uint8_t *data, size_t len);
+void font_free(font_t *font);
+
+/* the glyph showing a code point, -1 if there is none */
+int font_glyph_for(const font_t *font, uint32_t unicode);
+
+/* Load the font and its unicode table on the virtual terminal of fd.  Fails
+ * if fd is not a virtual terminal, such as a serial console or a pty. */
+bool font_load_console(int fd, const font_t *font);
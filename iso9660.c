@@ -0,0 +1,202 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "iso9660.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+/* offsets within ECMA-119 structures */
+#define VD_FIRST_SECTOR 16
+#define VD_TYPE_PRIMARY 1
+#define VD_TYPE_TERMINATOR 255
+#define VD_ROOT_RECORD 156
+
+#define DR_LENGTH 0
+#define DR_EXTENT 2
+#define DR_SIZE 10
+#define DR_FLAGS 25
+#define DR_NAME_LEN 32
+#define DR_NAME 33
+#define DR_FLAG_DIRECTORY 0x02
+
+/* directories on the images we look at are a few sectors, anything far
+ * beyond that is a corrupt image */
+#define MAX_DIRECTORY_SIZE (16 * 1024 * 1024)
+
+static uint32_t le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static bool read_fd(void *ctx, void *buf, size_t len, uint64_t offset)
+{
+    int fd = *(int *)ctx;
+    uint8_t *cur = buf;
+    while(len > 0) {
+        ssize_t rv = pread(fd, cur, len, offset);
+        if(rv <= 0) return false;
+        cur += rv;
+        len -= rv;
+        offset += rv;
+    }
+    return true;
+}
+
+static void extent_from_record(const uint8_t *record, iso_extent_t *ret)
+{
+    ret->offset = (uint64_t)le32(record + DR_EXTENT) * ISO9660_SECTOR_SIZE;
+    ret->size = le32(record + DR_SIZE);
+}
+
+/* The Rock Ridge NM entry, if any, in the system use area of the record */
+static bool rock_ridge_name(const uint8_t *record, const char **name,
+                            int *name_len)
+{
+    int len = record[DR_LENGTH];
+    /* the file identifier is padded to an even offset */
+    int cur = DR_NAME + record[DR_NAME_LEN] + !(record[DR_NAME_LEN] & 1);
+
+    while(cur + 4 <= len) {
+        const uint8_t *entry = record + cur;
+        int entry_len = entry[2];
+        if(entry_len < 4 || cur + entry_len > len) break;
+        if(entry[0] == 'N' && entry[1] == 'M' && entry_len > 5) {
+            *name = (const char *)entry + 5;
+            *name_len = entry_len - 5;
+            return true;
+        }
+        cur += entry_len;
+    }
+    return false;
+}
+
+static bool record_matches(const uint8_t *record, const char *component,
+                           int component_len)
+{
+    const char *name = NULL;
+    int name_len = 0;
+    if(rock_ridge_name(record, &name, &name_len)) {
+        return name_len == component_len
+            && memcmp(name, component, name_len) == 0;
+    }
+
+    /* plain names are like "VMLINUZ.;1" */
+    name = (const char *)record + DR_NAME;
+    name_len = record[DR_NAME_LEN];
+    const char *version = memchr(name, ';', name_len);
+    if(version) name_len = version - name;
+    if(name_len > 0 && name[name_len - 1] == '.') name_len--;
+
+    return name_len == component_len
+        && strncasecmp(name, component, name_len) == 0;
+}
+
+/* search the directory at dir for component, and update dir to point at the
+ * matching entry */
+static bool find_in_directory(iso_read_fn read_fn, void *ctx,
+                              iso_extent_t *dir, bool *is_dir,
+                              const char *component, int component_len)
+{
+    if(dir->size > MAX_DIRECTORY_SIZE) return false;
+
+    uint8_t *data = malloc(dir->size);
+    if(!data) return false;
+    if(!read_fn(ctx, data, dir->size, dir->offset)) {
+        free(data);
+        return false;
+    }
+
+    bool found = false;
+    uint64_t cur = 0;
+    while(cur + DR_NAME < dir->size) {
+        const uint8_t *record = data + cur;
+        int len = record[DR_LENGTH];
+        if(len == 0) {
+            /* records do not cross sectors, the rest is padding */
+            cur = (cur / ISO9660_SECTOR_SIZE + 1) * ISO9660_SECTOR_SIZE;
+            continue;
+        }
+        if(len < DR_NAME + record[DR_NAME_LEN] || cur + len > dir->size) {
+            break;
+        }
+        if(record_matches(record, component, component_len)) {
+            extent_from_record(record, dir);
+            *is_dir = record[DR_FLAGS] & DR_FLAG_DIRECTORY;
+            found = true;
+            break;
+        }
+        cur += len;
+    }
+
+    free(data);
+    return found;
+}
+
+static bool find_root(iso_read_fn read_fn, void *ctx, iso_extent_t *root)
+{
+    uint8_t sector[ISO9660_SECTOR_SIZE];
+    for(int i = VD_FIRST_SECTOR; ; i++) {
+        if(!read_fn(ctx, sector, sizeof(sector),
+                    (uint64_t)i * ISO9660_SECTOR_SIZE)) {
+            return false;
+        }
+        if(memcmp(sector + 1, "CD001", 5) != 0) return false;
+        if(sector[0] == VD_TYPE_TERMINATOR) return false;
+        if(sector[0] == VD_TYPE_PRIMARY) {
+            extent_from_record(sector + VD_ROOT_RECORD, root);
+            return true;
+        }
+    }
+}
+
+bool iso9660_find(int fd, const char *path, iso_extent_t *ret)
+{
+    if(fd < 0) return false;
+    return iso9660_find_by(read_fd, &fd, path, ret);
+}
+
+bool iso9660_find_by(iso_read_fn read_fn, void *ctx, const char *path,
+                     iso_extent_t *ret)
+{
+    if(!read_fn || !path || !ret) return false;
+
+    iso_extent_t cur = {};
+    if(!find_root(read_fn, ctx, &cur)) return false;
+    bool is_dir = true;
+
+    while(*path) {
+        const char *end = strchrnul(path, '/');
+        if(end != path) {
+            if(!is_dir) return false;
+            if(!find_in_directory(read_fn, ctx, &cur, &is_dir,
+                                  path, end - path)) {
+                return false;
+            }
+        }
+        path = *end ? end + 1 : end;
+    }
+
+    if(is_dir) return false;
+    *ret = cur;
+    return true;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ISO9660_SECTOR_SIZE 2048
+
+/* location of a file's data within an ISO9660 image */
+typedef struct _iso_extent_t
+{
+    uint64_t offset; /* in bytes from the start of the image */
+    uint64_t size; /* in bytes */
+} iso_extent_t;
+
+/* read exactly len bytes at offset within the image into buf */
+typedef bool (*iso_read_fn)(void *ctx, void *buf, size_t len,
+                            uint64_t offset);
+
+/* Locate the file at path, such as "casper/vmlinuz", in the image open on
+ * fd.  Each path component matches either the Rock Ridge name exactly, or the
+ * plain ISO9660 name without the version suffix, ignoring case. */
+bool iso9660_find(int fd, const char *path, iso_extent_t *ret);
+
+/* as iso9660_find(), reading the image through read_fn */
+bool iso9660_find_by(iso_read_fn read_fn, void *ctx, const char *path,
+                     iso_extent_t *ret);
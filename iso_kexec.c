@@ -0,0 +1,330 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Load the kernel and initrd of an ISO for kexec, straight from the image.
+ *
+ * The files are located by walking the ISO9660 directories, so there is no
+ * need for the isofs module or a mount.  kexec_file_load() only takes whole
+ * files, so each extent is copied into a memfd first.  Running the loaded
+ * kernel is left to "kexec --exec".
+ *
+ * With --url, the directories and both files are instead fetched from the
+ * image's URL with HTTP range requests while the whole image is still being
+ * downloaded to <image>.  Nothing is loaded until SIGUSR1 says the download
+ * has been verified, at which point the fetched files are checked against
+ * the verified image.  SIGTERM abandons the load.
+ */
+
+#include "common.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/sendfile.h>
+#include <sys/wait.h>
+
+#include "iso9660.h"
+#include "kexec_file.h"
+
+#define CHUNK_SIZE (1024 * 1024)
+
+noreturn void usage(char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--url=<image url>] "
+            "--command-line=<cmdline> | --command-line-file=<path> "
+            "<image> <kernel path> <initrd path>\n",
+            prog);
+    exit(1);
+}
+
+/* start wget on a range of url, returning the pipe its output arrives on */
+pid_t wget_range(const char *url, uint64_t offset, uint64_t len, int *ret_fd)
+{
+    int pipefd[2];
+    if(pipe2(pipefd, O_CLOEXEC) == -1) return -1;
+
+    char *range = saprintf("Range: bytes=%" PRIu64 "-%" PRIu64,
+                           offset, offset + len - 1);
+    pid_t pid = range ? fork() : -1;
+    if(pid == 0) {
+        dup2(pipefd[1], STDOUT_FILENO);
+        execlp("wget", "wget", "-q", "-O", "-", "--header", range, url, NULL);
+        _exit(127);
+    }
+
+    free(range);
+    close(pipefd[1]);
+    if(pid == -1) {
+        close(pipefd[0]);
+        return -1;
+    }
+    *ret_fd = pipefd[0];
+    return pid;
+}
+
+/* fetch len bytes at offset of url, into buf if set, otherwise to outfd */
+bool fetch_range(const char *url, uint64_t offset, uint64_t len,
+                 uint8_t *buf, int outfd)
+{
+    int fd = -1;
+    pid_t pid = wget_range(url, offset, len, &fd);
+    if(pid == -1) return false;
+
+    uint8_t *chunk = buf ? NULL : malloc(CHUNK_SIZE);
+    uint64_t done = 0;
+    while(done < len && (buf || chunk)) {
+        size_t want = MIN(len - done, CHUNK_SIZE);
+        uint8_t *dest = buf ? buf + done : chunk;
+        ssize_t rv = read(fd, dest, want);
+        if(rv <= 0) break;
+        if(!buf && write(outfd, chunk, rv) != rv) break;
+        done += rv;
+    }
+    free(chunk);
+
+    /* a server ignoring the range would keep sending */
+    close(fd);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return done == len;
+}
+
+/* Looking up both files reads the same descriptors and directories, which
+ * are kept so that each is only requested once. */
+#define FETCH_CACHE_SIZE 8
+
+typedef struct _fetch_ctx_t
+{
+    const char *url;
+    int len;
+    struct {
+        uint64_t offset;
+        size_t len;
+        uint8_t *data;
+    } cache[FETCH_CACHE_SIZE];
+} fetch_ctx_t;
+
+bool fetch_read(void *ctx, void *buf, size_t len, uint64_t offset)
+{
+    fetch_ctx_t *fetch = ctx;
+    for(int i = 0; i < fetch->len; i++) {
+        if(fetch->cache[i].offset == offset && fetch->cache[i].len == len) {
+            memcpy(buf, fetch->cache[i].data, len);
+            return true;
+        }
+    }
+
+    if(!fetch_range(fetch->url, offset, len, buf, -1)) return false;
+
+    if(fetch->len < FETCH_CACHE_SIZE) {
+        uint8_t *data = malloc(len);
+        if(data) {
+            memcpy(data, buf, len);
+            fetch->cache[fetch->len].offset = offset;
+            fetch->cache[fetch->len].len = len;
+            fetch->cache[fetch->len].data = data;
+            fetch->len++;
+        }
+    }
+    return true;
+}
+
+void fetch_ctx_free(fetch_ctx_t *fetch)
+{
+    for(int i = 0; i < fetch->len; i++) {
+        free(fetch->cache[i].data);
+    }
+    fetch->len = 0;
+}
+
+/* copy the extent of path into a new memfd, fetched if fetch is set,
+ * otherwise from the image */
+int extent_to_memfd(int fd, fetch_ctx_t *fetch, const char *path,
+                    const char *name, iso_extent_t *extent)
+{
+    bool found = fetch ? iso9660_find_by(fetch_read, fetch, path, extent)
+                       : iso9660_find(fd, path, extent);
+    if(!found) {
+        fprintf(stderr, "%s not found in image\n", path);
+        return -1;
+    }
+
+    int memfd = memfd_create(name, MFD_CLOEXEC);
+    if(memfd == -1) {
+        perror("memfd_create");
+        return -1;
+    }
+
+    if(fetch) {
+        if(!fetch_range(fetch->url, extent->offset, extent->size,
+                        NULL, memfd)) {
+            fprintf(stderr, "failed to fetch %s\n", path);
+            close(memfd);
+            return -1;
+        }
+        return memfd;
+    }
+
+    off_t offset = extent->offset;
+    size_t remaining = extent->size;
+    while(remaining > 0) {
+        ssize_t rv = sendfile(memfd, fd, &offset, remaining);
+        if(rv <= 0) {
+            fprintf(stderr, "failed to copy %s\n", path);
+            close(memfd);
+            return -1;
+        }
+        remaining -= rv;
+    }
+    return memfd;
+}
+
+/* check that what was fetched for path is what the image now holds */
+bool extent_matches_image(int fd, const char *path, iso_extent_t *fetched,
+                          int memfd)
+{
+    iso_extent_t extent = {};
+    if(!iso9660_find(fd, path, &extent)
+            || extent.offset != fetched->offset
+            || extent.size != fetched->size) {
+        fprintf(stderr, "%s moved in the downloaded image\n", path);
+        return false;
+    }
+
+    uint8_t *a = malloc(CHUNK_SIZE);
+    uint8_t *b = malloc(CHUNK_SIZE);
+    bool ret = a && b;
+    for(uint64_t done = 0; ret && done < extent.size; ) {
+        size_t len = MIN(extent.size - done, CHUNK_SIZE);
+        ret = pread(fd, a, len, extent.offset + done) == (ssize_t)len
+            && pread(memfd, b, len, done) == (ssize_t)len
+            && memcmp(a, b, len) == 0;
+        done += len;
+    }
+    free(a);
+    free(b);
+
+    if(!ret) fprintf(stderr, "%s differs from the downloaded image\n", path);
+    return ret;
+}
+
+char *read_command_line(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        perror(path);
+        return NULL;
+    }
+
+    char *line = NULL;
+    size_t len = 0;
+    ssize_t rv = getline(&line, &len, f);
+    fclose(f);
+    if(rv <= 0) {
+        free(line);
+        return NULL;
+    }
+    line[strcspn(line, "\n")] = '\0';
+    return line;
+}
+
+int main(int argc, char **argv)
+{
+    const char *url = NULL;
+    const char *cmdline_file = NULL;
+    char *cmdline = NULL;
+
+    int cur = 1;
+    for(; cur < argc && strncmp(argv[cur], "--", 2) == 0; cur++) {
+        if(strncmp(argv[cur], "--url=", 6) == 0) {
+            url = argv[cur] + 6;
+        } else if(strncmp(argv[cur], "--command-line=", 15) == 0) {
+            cmdline = strdup(argv[cur] + 15);
+        } else if(strncmp(argv[cur], "--command-line-file=", 20) == 0) {
+            cmdline_file = argv[cur] + 20;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if(argc - cur != 3 || !cmdline == !cmdline_file) usage(argv[0]);
+    const char *image = argv[cur];
+    const char *kernel_path = argv[cur + 1];
+    const char *initrd_path = argv[cur + 2];
+
+    /* held until sigwait(), so a signal arriving early is not lost */
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGTERM);
+    if(url) sigprocmask(SIG_BLOCK, &signals, NULL);
+
+    int fd = open(image, O_RDONLY | O_CLOEXEC);
+    if(fd == -1) {
+        perror(image);
+        return 1;
+    }
+
+    fetch_ctx_t fetch = {.url = url};
+    fetch_ctx_t *fetch_from = url ? &fetch : NULL;
+    iso_extent_t kernel_extent = {};
+    iso_extent_t initrd_extent = {};
+    int kernel = extent_to_memfd(fd, fetch_from, kernel_path, "kernel",
+                                 &kernel_extent);
+    if(kernel == -1) return 1;
+    int initrd = extent_to_memfd(fd, fetch_from, initrd_path, "initrd",
+                                 &initrd_extent);
+    if(initrd == -1) return 1;
+    fetch_ctx_free(&fetch);
+
+    if(url) {
+        int sig = 0;
+        sigwait(&signals, &sig);
+        if(sig != SIGUSR1) return 1;
+
+        if(!extent_matches_image(fd, kernel_path, &kernel_extent, kernel)
+                || !extent_matches_image(fd, initrd_path, &initrd_extent,
+                                         initrd)) {
+            return 1;
+        }
+    }
+
+    if(cmdline_file) cmdline = read_command_line(cmdline_file);
+    if(!cmdline) {
+        fprintf(stderr, "no command line\n");
+        return 1;
+    }
+
+    if(!kexec_file_load_fds(kernel, initrd, cmdline)) return 1;
+
+    free(cmdline);
+    close(kernel);
+    close(initrd);
+    close(fd);
+    return 0;
+}
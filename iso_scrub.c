@@ -0,0 +1,353 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Verify a directory of ISOs, such as the image cache of a build host,
+ * against the sha256 and size of the iso items in simplestreams JSON.
+ *
+ * An item such as bionic/ubuntu-18.04.6-live-server-amd64.iso is looked for
+ * in the directory at that path, then by its file name alone, then as
+ * <sha256>.iso, the name iso-cache stores it under.  Items without a file
+ * are skipped.  Several items may map to one file, such as two versions with
+ * the same file name, so each file is checked against the item of its size,
+ * preferring one found at its own path; a file no item fits is a mismatch
+ * without being read.  The rest are hashed by one thread per core, fed
+ * through a bounded queue.  Results are printed as they complete, then a
+ * summary:
+ *
+ * ok bionic/ubuntu-18.04.6-live-server-amd64.iso
+ * mismatch bionic/ubuntu-18.04.6-live-server-amd64.iso sha256 expected <sum>
+ *     actual <sum>
+ * scrub files=1 ok=1 mismatch=0 error=0 bytes=1016070144 seconds=2.31
+ *     avg_bps=439857205
+ *
+ * The exit status is 0 only if every file found matched.
+ */
+
+#include "common.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/param.h>
+
+#include "json.h"
+#include "scrub.h"
+#include "sha256.h"
+
+#define CHUNK_SIZE (4 * 1024 * 1024)
+
+/* queued files per worker */
+#define QUEUE_DEPTH 2
+
+typedef struct _job_t
+{
+    char *path; /* of the file to hash */
+    char *name; /* path of the item, for reporting */
+    char *sha256;
+    int64_t size;
+} job_t;
+
+typedef struct _queue_t
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    job_t **jobs; /* ring of capacity entries */
+    int capacity;
+    int head; /* index of the oldest job */
+    int len;
+    bool closed; /* no more jobs will be pushed */
+} queue_t;
+
+typedef struct _scrub_t
+{
+    const char *dir;
+    queue_t queue;
+
+    pthread_mutex_t report_lock;
+    int files;
+    int ok;
+    int mismatch;
+    int error;
+    int64_t bytes; /* hashed so far */
+} scrub_t;
+
+noreturn void usage(char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--jobs=<count>] <dir> <stream json> "
+            "[<stream json> ...]\n",
+            prog);
+    exit(1);
+}
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void job_free(job_t *job)
+{
+    if(!job) return;
+    free(job->path);
+    free(job->name);
+    free(job->sha256);
+    free(job);
+}
+
+bool queue_init(queue_t *queue, int capacity)
+{
+    queue->jobs = calloc(sizeof(job_t *), capacity);
+    if(!queue->jobs) return false;
+    queue->capacity = capacity;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return true;
+}
+
+/* wait for room in the queue, so reading ahead stays bounded */
+void queue_push(queue_t *queue, job_t *job)
+{
+    pthread_mutex_lock(&queue->lock);
+    while(queue->len == queue->capacity) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    queue->jobs[(queue->head + queue->len++) % queue->capacity] = job;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/* the next job, or NULL once the queue is closed and drained */
+job_t *queue_pop(queue_t *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    while(queue->len == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    job_t *job = NULL;
+    if(queue->len > 0) {
+        job = queue->jobs[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->len--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return job;
+}
+
+void queue_close(queue_t *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void queue_destroy(queue_t *queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->jobs);
+}
+
+/* print one result line, and count it */
+void report(scrub_t *scrub, int *counter, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+void report(scrub_t *scrub, int *counter, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pthread_mutex_lock(&scrub->report_lock);
+    vprintf(fmt, ap);
+    fflush(stdout);
+    scrub->files++;
+    (*counter)++;
+    pthread_mutex_unlock(&scrub->report_lock);
+    va_end(ap);
+}
+
+/* hash a file into hex, adding to the bytes hashed as it goes */
+bool hash_file(scrub_t *scrub, const char *path, int64_t size, uint8_t *buf,
+               char *hex)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1) return false;
+    posix_fadvise(fd, 0, size, POSIX_FADV_SEQUENTIAL);
+
+    sha256_t ctx;
+    sha256_init(&ctx);
+    int64_t done = 0;
+    while(done < size) {
+        ssize_t rv = read(fd, buf, MIN(size - done, CHUNK_SIZE));
+        if(rv <= 0) break;
+        sha256_update(&ctx, buf, rv);
+        done += rv;
+
+        pthread_mutex_lock(&scrub->report_lock);
+        scrub->bytes += rv;
+        pthread_mutex_unlock(&scrub->report_lock);
+    }
+    close(fd);
+    if(done != size) return false;
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256_final(&ctx, digest);
+    sha256_hex(digest, hex);
+    return true;
+}
+
+void *worker(void *arg)
+{
+    scrub_t *scrub = arg;
+    uint8_t *buf = malloc(CHUNK_SIZE);
+
+    job_t *job = NULL;
+    while((job = queue_pop(&scrub->queue))) {
+        char actual[SHA256_DIGEST_SIZE * 2 + 1];
+        if(!buf || !hash_file(scrub, job->path, job->size, buf, actual)) {
+            report(scrub, &scrub->error, "error %s failed to read %s\n",
+                   job->name, job->path);
+        } else if(strcasecmp(actual, job->sha256) != 0) {
+            report(scrub, &scrub->mismatch,
+                   "mismatch %s sha256 expected %s actual %s\n",
+                   job->name, job->sha256, actual);
+        } else {
+            report(scrub, &scrub->ok, "ok %s\n", job->name);
+        }
+        job_free(job);
+    }
+
+    free(buf);
+    return NULL;
+}
+
+/* hash the file against the item of its size, or report that none fits */
+bool check_file(scrub_t *scrub, scrub_file_t *file)
+{
+    bool sized = false;
+    const scrub_item_t *item = scrub_pick(file, &sized);
+    if(!sized) {
+        report(scrub, &scrub->mismatch,
+               "mismatch %s size expected %" PRId64 " actual %" PRId64 "\n",
+               item->name, item->size, file->size);
+        return true;
+    }
+
+    job_t *job = calloc(sizeof(job_t), 1);
+    if(!job) return false;
+    job->path = strdup(file->path);
+    job->name = strdup(item->name);
+    job->sha256 = strdup(item->sha256);
+    job->size = item->size;
+    if(!job->path || !job->name || !job->sha256) {
+        job_free(job);
+        return false;
+    }
+    queue_push(&scrub->queue, job);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int cur = 1;
+    for(; cur < argc && strncmp(argv[cur], "--", 2) == 0; cur++) {
+        if(strncmp(argv[cur], "--jobs=", 7) == 0) {
+            char *end = NULL;
+            jobs = strtol(argv[cur] + 7, &end, 10);
+            if(*end || jobs < 1) usage(argv[0]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if(argc - cur < 2) usage(argv[0]);
+    if(jobs < 1) jobs = 1;
+
+    scrub_match_t match = {.dir = argv[cur++]};
+    scrub_t scrub = {};
+    pthread_mutex_init(&scrub.report_lock, NULL);
+    if(!queue_init(&scrub.queue, jobs * QUEUE_DEPTH)) {
+        fprintf(stderr, "alloc failure\n");
+        return 1;
+    }
+
+    pthread_t *threads = calloc(sizeof(pthread_t), jobs);
+    if(!threads) {
+        fprintf(stderr, "alloc failure\n");
+        return 1;
+    }
+    double start = now();
+    for(long i = 0; i < jobs; i++) {
+        if(pthread_create(&threads[i], NULL, worker, &scrub) != 0) {
+            fprintf(stderr, "failed to start worker\n");
+            return 1;
+        }
+    }
+
+    for(; cur < argc; cur++) {
+        json_object *root = json_object_from_file(argv[cur]);
+        if(!root || !foreach_iso_item(root, scrub_add_item, &match)) {
+            fprintf(stderr, "failed to read stream %s\n", argv[cur]);
+            pthread_mutex_lock(&scrub.report_lock);
+            scrub.error++;
+            pthread_mutex_unlock(&scrub.report_lock);
+        }
+        json_object_put(root);
+    }
+    for(int i = 0; i < match.len; i++) {
+        if(!check_file(&scrub, &match.files[i])) {
+            fprintf(stderr, "alloc failure\n");
+            return 1;
+        }
+    }
+    scrub_match_free(&match);
+
+    queue_close(&scrub.queue);
+    for(long i = 0; i < jobs; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now() - start;
+
+    printf("scrub files=%d ok=%d mismatch=%d error=%d bytes=%" PRId64
+           " seconds=%.2f avg_bps=%.0f\n",
+           scrub.files, scrub.ok, scrub.mismatch, scrub.error, scrub.bytes,
+           elapsed, elapsed > 0 ? scrub.bytes / elapsed : 0);
+
+    free(threads);
+    queue_destroy(&scrub.queue);
+    pthread_mutex_destroy(&scrub.report_lock);
+
+    return scrub.mismatch == 0 && scrub.error == 0 ? 0 : 1;
+}
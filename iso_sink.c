@@ -0,0 +1,216 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Write the image arriving on stdin, usually from wget, to the reserved
+ * memory device while avoiding extra copies through user space and the page
+ * cache where the target allows it.  See sink.h for the strategies.
+ *
+ * The number of bytes written is printed on stdout, so that a download cut
+ * short can be resumed from there with --offset.  With --progress, transfer
+ * progress is shown on stderr while writing.  A summary for later analysis is
+ * always logged at the end, in the form:
+ *
+ * download offset=0 bytes=1642631168 seconds=35.20 avg_bps=46665658
+ *     retries=0 strategy=splice result=ok
+ */
+
+#include "common.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/param.h>
+
+#include "sink.h"
+
+/* how often the progress line is redrawn, in seconds */
+#define PROGRESS_INTERVAL 0.5
+
+typedef struct _progress_t
+{
+    int64_t offset; /* bytes already in place from earlier attempts */
+    int64_t total; /* size of the whole image, 0 if unknown */
+    int retries; /* attempts before this one */
+    bool live; /* stderr is a terminal to draw progress on */
+    double start;
+    double last_time; /* of the last redraw */
+    int64_t last_written; /* at the last redraw */
+} progress_t;
+
+noreturn void usage(char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--strategy=auto|mmap|splice|direct|write] "
+            "[--offset=<bytes>] [--size=<bytes>] [--retries=<count>] "
+            "[--progress] <target>\n",
+            prog);
+    exit(1);
+}
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* format bytes in the largest unit that keeps it at or above 1 */
+char *human(double bytes)
+{
+    const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while(bytes >= 1024 && unit < 4) {
+        bytes /= 1024;
+        unit++;
+    }
+    return saprintf("%.1f %s", bytes, units[unit]);
+}
+
+int terminal_width(void)
+{
+    struct winsize ws = {};
+    if(ioctl(STDERR_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0) {
+        return 80;
+    }
+    return ws.ws_col;
+}
+
+/* Draw white on orange across the whole line, like the banner of
+ * iso-chooser-menu.  Only the basic console colors are to hand here, and as in
+ * the menu without can_change_color(), red stands in for orange. */
+void draw_progress(progress_t *progress, int64_t written, double rate)
+{
+    double elapsed = now() - progress->start;
+    double avg = elapsed > 0 ? written / elapsed : 0;
+    int64_t done = progress->offset + written;
+
+    char *done_text = human(done);
+    char *rate_text = human(rate);
+    char *avg_text = human(avg);
+    char *line = NULL;
+    if(progress->total > 0) {
+        char *total_text = human(progress->total);
+        int eta = avg > 0 ? (progress->total - done) / avg : 0;
+        line = saprintf(" Downloading %s / %s (%d%%)  %s/s now, %s/s avg  "
+                        "ETA %d:%02d  retries %d",
+                        done_text, total_text,
+                        (int)(done * 100 / progress->total),
+                        rate_text, avg_text, eta / 60, eta % 60,
+                        progress->retries);
+        free(total_text);
+    } else {
+        line = saprintf(" Downloading %s  %s/s now, %s/s avg  retries %d",
+                        done_text, rate_text, avg_text, progress->retries);
+    }
+
+    if(line) {
+        int width = terminal_width() - 1;
+        fprintf(stderr, "\r\033[1;37;41m%-*.*s\033[0m", width, width, line);
+        fflush(stderr);
+    }
+    free(line);
+    free(done_text);
+    free(rate_text);
+    free(avg_text);
+}
+
+void on_progress(sink_t *sink, int64_t written)
+{
+    progress_t *progress = sink->ctx;
+    double t = now();
+    if(t - progress->last_time < PROGRESS_INTERVAL) return;
+
+    double rate = (written - progress->last_written)
+                / (t - progress->last_time);
+    progress->last_time = t;
+    progress->last_written = written;
+    draw_progress(progress, written, rate);
+}
+
+int64_t parse_count(char *prog, const char *text)
+{
+    char *end = NULL;
+    long long ret = strtoll(text, &end, 10);
+    if(!*text || *end || ret < 0) usage(prog);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    sink_t sink = {.strategy = SINK_AUTO, .size = -1, .used = SINK_INVALID};
+    progress_t progress = {};
+    bool show_progress = false;
+
+    int cur = 1;
+    for(; cur < argc && strncmp(argv[cur], "--", 2) == 0; cur++) {
+        if(strncmp(argv[cur], "--strategy=", 11) == 0) {
+            sink.strategy = sink_strategy_from_name(argv[cur] + 11);
+            if(sink.strategy == SINK_INVALID) usage(argv[0]);
+        } else if(strncmp(argv[cur], "--size=", 7) == 0) {
+            sink.size = parse_count(argv[0], argv[cur] + 7);
+        } else if(strncmp(argv[cur], "--offset=", 9) == 0) {
+            sink.offset = parse_count(argv[0], argv[cur] + 9);
+        } else if(strncmp(argv[cur], "--retries=", 10) == 0) {
+            progress.retries = parse_count(argv[0], argv[cur] + 10);
+        } else if(strcmp(argv[cur], "--progress") == 0) {
+            show_progress = true;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if(argc - cur != 1) usage(argv[0]);
+
+    progress.offset = sink.offset;
+    progress.total = sink.size >= 0 ? sink.offset + sink.size : 0;
+    progress.live = show_progress && isatty(STDERR_FILENO);
+    progress.start = progress.last_time = now();
+    if(progress.live) {
+        sink.progress = on_progress;
+        sink.ctx = &progress;
+    }
+
+    int64_t written = sink_copy(STDIN_FILENO, argv[cur], &sink);
+    double elapsed = now() - progress.start;
+    bool ok = written >= 0 && (sink.size < 0 || written == sink.size);
+
+    if(progress.live) fprintf(stderr, "\r\033[K");
+    char *summary = saprintf(
+            "download offset=%" PRId64 " bytes=%" PRId64 " seconds=%.2f "
+            "avg_bps=%.0f retries=%d strategy=%s result=%s",
+            sink.offset, MAX(written, 0), elapsed,
+            elapsed > 0 ? MAX(written, 0) / elapsed : 0, progress.retries,
+            sink_strategy_name(sink.used) ?: "none",
+            ok ? "ok" : written >= 0 ? "short" : "error");
+    if(summary) {
+        syslog(LOG_INFO, "%s", summary);
+        if(show_progress) fprintf(stderr, "%s\n", summary);
+        free(summary);
+    }
+
+    printf("%" PRId64 "\n", MAX(written, 0));
+    return ok ? 0 : 1;
+}
@@ -18,16 +18,19 @@
  */
 
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
 
 #include <json-c/json.h>
 
 #include "json.h"
+#include "policy.h"
+#include "scan.h"
 
-/* The way this mini.iso chainboots depends on PMEM kernel modules,
- * and ISOs below 22.04.2 have kernels that don't have those modules.*/
-#define MINIMUM_UBUNTU_VERSION "22.04.2"
+/* set with set_policy(), NULL if there is no policy file */
+static const policy_t *active_policy;
 
 criteria_t content_id_to_criteria[] = {
     {
@@ -72,6 +75,57 @@ criteria_t *criteria_for_content_id(const char *content_id)
     return NULL;
 }
 
+void set_policy(const policy_t *policy)
+{
+    active_policy = policy;
+}
+
+bool criteria_add_mirror(const char *content_id, const char *urlbase)
+{
+    criteria_t *criteria = criteria_for_content_id(content_id);
+    if(!criteria || !urlbase) return false;
+    if(criteria->num_mirrors >= MAX_MIRRORS) return false;
+
+    char *mirror = strdup(urlbase);
+    if(!mirror) return false;
+    /* paths are joined with a '/' of their own */
+    size_t len = strlen(mirror);
+    while(len > 0 && mirror[len - 1] == '/') mirror[--len] = '\0';
+
+    criteria->mirrors[criteria->num_mirrors++] = mirror;
+    return true;
+}
+
+/* read mirrors from a file of "<content_id> <urlbase>" lines, where blank
+ * lines and those starting with '#' are ignored.  Returns how many mirrors
+ * were added, or -1 if the file can't be read. */
+int criteria_load_mirrors(const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if(!f) {
+        syslog(LOG_ERR, "failed to open mirrors file [%s]: %m", filename);
+        return -1;
+    }
+
+    int count = 0;
+    char *line = NULL;
+    size_t size = 0;
+    while(getline(&line, &size, f) != -1) {
+        char content_id[256], urlbase[1024];
+        if(line[0] == '#') continue;
+        if(sscanf(line, "%255s %1023s", content_id, urlbase) != 2) continue;
+        if(!criteria_add_mirror(content_id, urlbase)) {
+            syslog(LOG_WARNING, "ignoring mirror [%s] for [%s]",
+                   urlbase, content_id);
+            continue;
+        }
+        count++;
+    }
+    free(line);
+    fclose(f);
+    return count;
+}
+
 json_object *get(json_object *obj, const char *key)
 {
     if(!obj || !key) return NULL;
@@ -167,22 +221,40 @@ iso_data_t *iso_data_for_product(json_object *product, criteria_t *criteria)
     json_object *size = get(iso, "size");
     if(!size) return NULL;
 
-    return iso_data_create(
+    iso_data_t *ret = iso_data_create(
             saprintf("%s %s (%s)",
                      criteria->descriptor, str(title), str(codename)),
             saprintf("%s/%s", criteria->urlbase, str(path)),
             strdup(str(sha256)),
             json_object_get_int64(size));
+    if(!ret) return NULL;
+    ret->version = strdup(str(title));
+    ret->os = strdup(criteria->os);
+
+    for(int i = 0; i < criteria->num_mirrors; i++) {
+        char *prev = ret->mirrors;
+        ret->mirrors = saprintf("%s%s%s/%s", prev ? prev : "", prev ? " " : "",
+                                criteria->mirrors[i], str(path));
+        free(prev);
+    }
+    return ret;
 }
 
-bool choices_extend_from_json(choices_t *choices, const char *filename,
+bool product_is_viable(json_object *product, criteria_t *criteria,
+                       const char *arch)
+{
+    if(arch && !eq(str(get(product, "arch")), arch)) return false;
+    if(!eq(str(get(product, "os")), criteria->os)) return false;
+    if(!eq(str(get(product, "image_type")), criteria->image_type))
+        return false;
+    return policy_allows(active_policy, product);
+}
+
+bool choices_extend_from_root(choices_t *choices, json_object *root,
                               const char *arch)
 {
     /* extend the choices available to include all viable isos
-     * found in this file */
-    json_object *root = json_object_from_file(filename);
-    if(!root) return false;
-
+     * found in this already parsed stream */
     const char *content_id = str(get(root, "content_id"));
     criteria_t *criteria = criteria_for_content_id(content_id);
     if(!criteria) return false;
@@ -193,12 +265,7 @@ bool choices_extend_from_json(choices_t *choices, const char *filename,
     json_object_object_foreach(products, product_key, product) {
         (void)product_key;
 
-        if(!eq(str(get(product, "arch")), arch)) continue;
-        if(!eq(str(get(product, "os")), criteria->os)) continue;
-        if(!eq(str(get(product, "image_type")), criteria->image_type))
-            continue;
-        if(lt(str(get(product, "release_title")), MINIMUM_UBUNTU_VERSION))
-            continue;
+        if(!product_is_viable(product, criteria, arch)) continue;
         json_object *versions = get(product, "versions");
         if(!versions) continue;
         json_object *newest = find_largest_key(versions, NULL);
@@ -209,13 +276,38 @@ bool choices_extend_from_json(choices_t *choices, const char *filename,
 
     }
 
-    json_object_put(root);
     return true;
 }
 
+json_object *stream_from_file(const char *filename)
+{
+    /* the scanner only when asked for, json-c being the default */
+    const char *backend = getenv("ISO_CHOOSER_JSON_BACKEND");
+    bool scan = eq(backend, "simd");
+    if(backend && !scan && !eq(backend, "json-c")) {
+        scan = scan_use_kernel(backend);
+    }
+    if(scan && scan_kernel_name()) {
+        json_object *root = scan_stream_file(filename);
+        if(root) return root;
+    }
+    return json_object_from_file(filename);
+}
+
+bool choices_extend_from_json(choices_t *choices, const char *filename,
+                              const char *arch)
+{
+    json_object *root = stream_from_file(filename);
+    if(!root) return false;
+
+    bool ret = choices_extend_from_root(choices, root, arch);
+    json_object_put(root);
+    return ret;
+}
+
 iso_data_t *get_newest_iso(const char *filename, const char *arch)
 {
-    json_object *root = json_object_from_file(filename);
+    json_object *root = stream_from_file(filename);
     if(!root) return NULL;
 
     const char *content_id = str(get(root, "content_id"));
@@ -232,3 +324,113 @@ iso_data_t *get_newest_iso(const char *filename, const char *arch)
     json_object_put(root);
     return ret;
 }
+
+bool foreach_iso_item(json_object *root, iso_item_fn fn, void *ctx)
+{
+    json_object *products = get(root, "products");
+    if(!products) return false;
+
+    json_object_object_foreach(products, product_key, product) {
+        (void)product_key;
+        json_object *versions = get(product, "versions");
+        if(!versions) continue;
+
+        json_object_object_foreach(versions, version_key, version) {
+            (void)version_key;
+            json_object *items = get(version, "items");
+            if(!items) continue;
+
+            json_object_object_foreach(items, item_key, item) {
+                (void)item_key;
+                if(!eq(str(get(item, "ftype")), "iso")) continue;
+                const char *path = str(get(item, "path"));
+                const char *sha256 = str(get(item, "sha256"));
+                json_object *size = get(item, "size");
+                if(!path || !sha256 || !size) continue;
+                if(!fn(ctx, path, sha256, json_object_get_int64(size)))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* add obj[key] to dest, sharing rather than copying the value */
+bool copy_key(json_object *dest, json_object *obj, const char *key)
+{
+    json_object *val = get(obj, key);
+    if(!val) return true;
+    return json_object_object_add(dest, key, json_object_get(val)) == 0;
+}
+
+/* a product trimmed down to what the menu reads: the descriptive keys, and
+ * the iso item of the newest version */
+json_object *prune_product(json_object *product)
+{
+    const char *version_key = NULL;
+    json_object *newest = find_largest_key(get(product, "versions"),
+                                           &version_key);
+    json_object *iso = get(get(newest, "items"), "iso");
+    if(!iso) return NULL;
+
+    json_object *ret = json_object_new_object();
+    json_object *versions = json_object_new_object();
+    json_object *version = json_object_new_object();
+    json_object *items = json_object_new_object();
+    if(!ret || !versions || !version || !items) goto fail;
+
+    const char *keys[] = {
+        "arch", "os", "image_type", "release", "release_codename",
+        "release_title", "version", NULL
+    };
+    for(int i = 0; keys[i]; i++) {
+        if(!copy_key(ret, product, keys[i])) goto fail;
+    }
+
+    json_object_object_add(items, "iso", json_object_get(iso));
+    json_object_object_add(version, "items", items);
+    items = NULL;
+    json_object_object_add(versions, version_key, version);
+    version = NULL;
+    json_object_object_add(ret, "versions", versions);
+    return ret;
+
+fail:
+    json_object_put(items);
+    json_object_put(version);
+    json_object_put(versions);
+    json_object_put(ret);
+    return NULL;
+}
+
+json_object *prune_stream(json_object *root, const char *arch)
+{
+    criteria_t *criteria = criteria_for_content_id(
+            str(get(root, "content_id")));
+    if(!criteria) return NULL;
+    json_object *products = get(root, "products");
+    if(!products) return NULL;
+
+    json_object *ret = json_object_new_object();
+    json_object *pruned = json_object_new_object();
+    if(!ret || !pruned) goto fail;
+
+    const char *keys[] = {"content_id", "datatype", "format", "updated", NULL};
+    for(int i = 0; keys[i]; i++) {
+        if(!copy_key(ret, root, keys[i])) goto fail;
+    }
+
+    json_object_object_foreach(products, product_key, product) {
+        if(!product_is_viable(product, criteria, arch)) continue;
+        json_object *cur = prune_product(product);
+        if(!cur) continue;
+        json_object_object_add(pruned, product_key, cur);
+    }
+    json_object_object_add(ret, "products", pruned);
+    return ret;
+
+fail:
+    json_object_put(pruned);
+    json_object_put(ret);
+    return NULL;
+}
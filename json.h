@@ -25,6 +25,8 @@
 
 #include "common.h"
 
+#define MAX_MIRRORS 8
+
 json_object *get(json_object *obj, const char *key);
 const char *str(json_object *obj);
 bool eq(const char *a, const char *b);
@@ -51,14 +53,51 @@ typedef struct _criteria_t
     /* descriptor is friendly description of the product,
      * such as "Ubuntu Server" */
     const char *descriptor;
+
+    /* mirrors are further urlbases serving the same paths, configured at
+     * runtime with criteria_load_mirrors() */
+    int num_mirrors;
+    char *mirrors[MAX_MIRRORS];
 } criteria_t;
 
+typedef struct _policy_t policy_t;
+
+/* the policy applied by product_is_viable(), see policy.h */
+void set_policy(const policy_t *policy);
+
 criteria_t *criteria_for_content_id(const char *content_id);
+bool criteria_add_mirror(const char *content_id, const char *urlbase);
+int criteria_load_mirrors(const char *filename);
+
+/* A parsed stream with at least the keys the menu reads.  It comes from
+ * json_object_from_file(), unless ISO_CHOOSER_JSON_BACKEND is "simd" or names
+ * a scan kernel, see scan.h, in which case it comes from scan_stream_file()
+ * where that kernel is supported and the scan succeeds. */
+json_object *stream_from_file(const char *filename);
 
+bool choices_extend_from_root(choices_t *choices, json_object *root,
+                              const char *arch);
 bool choices_extend_from_json(choices_t *choices, const char *filename,
                               const char *arch);
 iso_data_t *get_newest_iso(const char *filename, const char *arch);
 
+/* whether the menu would offer this product, for any arch if arch is NULL,
+ * under the policy set with set_policy() */
+bool product_is_viable(json_object *product, criteria_t *criteria,
+                       const char *arch);
+
+/* a copy of a parsed stream with only what the menu reads: the products it
+ * would offer for arch, or for any arch if NULL, each with just the iso item
+ * of its newest version.  Returns NULL if the stream is not one the menu
+ * knows. */
+json_object *prune_stream(json_object *root, const char *arch);
+
+/* called for each iso item in a stream, with every version of every product
+ * of any arch, until it returns false */
+typedef bool (*iso_item_fn)(void *ctx, const char *path, const char *sha256,
+                            int64_t size);
+bool foreach_iso_item(json_object *root, iso_item_fn fn, void *ctx);
+
 json_object *find_largest_key(json_object *obj, const char **ret_key);
 json_object *find_newest_product(json_object *products, const char **ret_key,
                                  const char *arch, const char *os,
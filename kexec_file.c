@@ -0,0 +1,42 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "kexec_file.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/syscall.h>
+
+bool kexec_file_load_fds(int kernel, int initrd, const char *cmdline)
+{
+#ifdef SYS_kexec_file_load
+    if(syscall(SYS_kexec_file_load, kernel, initrd,
+               strlen(cmdline) + 1, cmdline, 0) == -1) {
+        perror("kexec_file_load");
+        return false;
+    }
+    return true;
+#else
+    fprintf(stderr, "kexec_file_load is not available on " ARCH "\n");
+    return false;
+#endif
+}
@@ -34,6 +34,29 @@
  * MEDIA_URL="https://releases.ubuntu.com/kinetic/ubuntu-22.10-live-server-amd64.iso"
  * MEDIA_LABEL="Ubuntu Server 22.10 (Kinetic Kudu)"
  * MEDIA_SIZE="1642631168"
+ * MEDIA_MIRRORS=""
+ *
+ * With --mirrors=<path>, a file of "<content_id> <urlbase>" lines, the same
+ * ISO on each of those mirrors is listed in MEDIA_MIRRORS, space separated.
+ *
+ * With --policy=<path>, the choices offered and their order follow that
+ * policy file, see policy.h.
+ *
+ * With --console-font, the font the menu is drawn with is first loaded on the
+ * console, as setfont would.  It and the terminfo entry for linux-c are
+ * compiled in, see embedded.h.
+ *
+ * With --refresh=<marker>, the input files are a snapshot of the streams and
+ * the menu is shown from them straight away, then redrawn from the streams
+ * listed in the marker file once it appears, see refresh.h.  A choice made
+ * before then waits for the marker, and is only made if the image chosen is
+ * still the same.
+ *
+ * With --max-size=<bytes>, only ISOs of at most that size are offered, as when
+ * step 2 offers another choice in the memory step 1 reserved.
+ *
+ * With --timing=<path>, the duration of each startup phase is also written to
+ * that path, one "<phase> <usec>" per line.
  */
 
 #include "common.h"
@@ -47,10 +70,18 @@
 #include <string.h>
 #include <syslog.h>
 #include <stdnoreturn.h>
+#include <unistd.h>
 #include <sys/param.h>
 
 #include "args.h"
+#include "dedupe.h"
+#include "embedded.h"
+#include "font.h"
 #include "json.h"
+#include "policy.h"
+#include "refresh.h"
+#include "terminfo.h"
+#include "timing.h"
 
 int ubuntu_orange = COLOR_RED;
 int text_white = COLOR_WHITE;
@@ -59,7 +90,9 @@ int back_green = COLOR_GREEN;
 noreturn void usage(char *prog)
 {
     fprintf(stderr,
-            "usage: %s <output path> <input json> [<input json> ...]\n",
+            "usage: %s [--timing=<path>] [--mirrors=<path>] [--policy=<path>] "
+            "[--console-font] [--refresh=<marker>] [--max-size=<bytes>] "
+            "<output path> <input json> [<input json> ...]\n",
             prog);
     exit(1);
 }
@@ -70,13 +103,47 @@ typedef enum {
     INCREASE=1,
 } choice_event;
 
-choices_t *read_iso_choices(args_t *args)
+/* how often the refresh marker is looked for */
+#define REFRESH_POLL_MS 200
+/* how long a choice waits on the refresh before standing as it is */
+#define REFRESH_WAIT_MS 10000
+/* how long a status line is shown before the menu exits */
+#define STATUS_HOLD_MS 1000
+
+choices_t *read_iso_choices(char **infiles, int num_infiles, policy_t *policy,
+                            int64_t max_size)
 {
     int capacity = 10;  /* 5 release ISOs * (desktop, server) */
     choices_t *choices = choices_create(capacity);
-    for(int i = 0; i < args->num_infiles; i++) {
-        choices_extend_from_json(choices, args->infiles[i], ARCH);
+    dedupe_t *dedupe = choices ? dedupe_create(choices, policy) : NULL;
+    if(!dedupe) {
+        choices_free(choices);
+        return NULL;
+    }
+    for(int i = 0; i < num_infiles; i++) {
+        char *name = basename(infiles[i]);
+        json_object *root = stream_from_file(infiles[i]);
+        timing_phase("load:%s", name);
+        if(!root) continue;
+
+        /* streams may overlap, so each is merged in rather than appended */
+        choices_t *found = choices_create(capacity);
+        if(found) choices_extend_from_root(found, root, ARCH);
+        for(int j = 0; found && j < found->len; j++) {
+            if((max_size && found->values[j]->size > max_size)
+                    || !dedupe_append(dedupe, found->values[j])) {
+                iso_data_free(found->values[j]);
+            }
+        }
+        /* the values now belong to choices */
+        if(found) found->len = 0;
+        choices_free(found);
+        json_object_put(root);
+        timing_phase("filter:%s", name);
     }
+    dedupe_free(dedupe);
+    policy_sort(policy, choices);
+    timing_phase("sort");
     return choices;
 }
 
@@ -155,6 +222,14 @@ void add_chooser(choices_t *choices, int selected)
     }
 }
 
+/* a line of text under the choices, or clear that line if text is NULL */
+void status_line(const char *text)
+{
+    move(LINES - 2, 0);
+    clrtoeol();
+    if(text) mvaddstr(LINES - 2, horizontal_center(strlen(text)), text);
+}
+
 int color_byte_to_ncurses(uint8_t color_byte)
 {
     return color_byte / 255.0 * 1000;
@@ -181,6 +256,8 @@ void write_output(char *fname, iso_data_t *iso_data)
     fprintf(f, "MEDIA_LABEL=\"%s\"\n", iso_data->label);
     fprintf(f, "MEDIA_256SUM=\"%s\"\n", iso_data->sha256sum);
     fprintf(f, "MEDIA_SIZE=\"%" PRId64 "\"\n", iso_data->size);
+    fprintf(f, "MEDIA_MIRRORS=\"%s\"\n",
+            iso_data->mirrors ? iso_data->mirrors : "");
     fclose(f);
 }
 
@@ -194,7 +271,9 @@ void choice_handle_event(args_t *args, choices_t *choices, choice_event evt)
             break;
         case SELECT:
             iso_data_t *cur = choices->values[choices->cur];
+            timing_phase("selection");
             write_output(args->outfile, cur);
+            timing_phase("output");
             syslog(LOG_DEBUG, "selected:%s %s %" PRId64,
                    cur->label, cur->url, cur->size);
             break;
@@ -209,6 +288,29 @@ void choice_handle_event(args_t *args, choices_t *choices, choice_event evt)
     }
 }
 
+/* Swap in the choices from the streams listed in the refresh marker, if it
+ * exists yet.  Returns false if it doesn't, else true with same set to whether
+ * the selected choice is still the same image. */
+bool apply_refresh(args_t *args, policy_t *policy, choices_t *choices,
+                   bool *same)
+{
+    int num_streams = 0;
+    char **streams = refresh_read_marker(args->refresh_path, &num_streams);
+    if(!streams) return false;
+
+    choices_t *fresh = read_iso_choices(streams, num_streams, policy,
+                                        args->max_size);
+    refresh_free_streams(streams);
+    /* an empty marker is no news, the snapshot being up to date */
+    if(fresh && fresh->len == 0 && num_streams > 0) {
+        syslog(LOG_WARNING, "no choices in the refreshed streams, keeping "
+               "the snapshot");
+    }
+    *same = fresh ? choices_refresh(choices, fresh) : true;
+    timing_phase("refresh");
+    return true;
+}
+
 void exit_cb(void)
 {
     erase();
@@ -218,21 +320,60 @@ void exit_cb(void)
 
 int main(int argc, char **argv)
 {
+    timing_start();
+
     args_t *args = args_create(argc, argv);
     if(!args) usage(argv[0]);
+    timing_phase("args");
+
+    /* the glyphs drawn only need the character encoding of the locale */
+    setlocale(LC_CTYPE, "C.UTF-8");
+
+    if(args->mirrors_path && criteria_load_mirrors(args->mirrors_path) < 0) {
+        usage(argv[0]);
+    }
 
-    setlocale(LC_ALL, "C.UTF-8");
+    policy_t *policy = NULL;
+    if(args->policy_path) {
+        policy = policy_load(args->policy_path);
+        if(!policy) usage(argv[0]);
+        set_policy(policy);
+    }
 
-    choices_t *iso_info = read_iso_choices(args);
+    choices_t *iso_info = read_iso_choices(args->infiles, args->num_infiles,
+                                           policy, args->max_size);
     if(!iso_info) {
         syslog(LOG_ERR, "failed to read JSON data");
         return 1;
     }
+    /* a refresh may yet bring some */
+    if(!iso_info->len && !args->refresh_path) {
+        syslog(LOG_ERR, "no ISOs to offer");
+        return 1;
+    }
 
-    if(!initscr()) {
+    if(args->console_font) {
+        font_t *font = font_parse(embedded_font, embedded_font_len);
+        if(!font || !font_load_console(STDIN_FILENO, font)) {
+            syslog(LOG_WARNING, "failed to load the console font");
+        }
+        font_free(font);
+        timing_phase("font");
+    }
+
+    /* ncurses reads the entry during initscr(), after which it can go */
+    char *terminfo_dir = NULL;
+    if(eq(getenv("TERM"), EMBEDDED_TERM)) {
+        terminfo_dir = terminfo_install(EMBEDDED_TERM, embedded_terminfo,
+                                        embedded_terminfo_len);
+    }
+    WINDOW *screen = initscr();
+    terminfo_remove(terminfo_dir, EMBEDDED_TERM);
+    if(!screen) {
         syslog(LOG_ERR, "initscr failure");
         return 1;
     }
+    timing_phase("initscr");
 
     atexit(exit_cb);
 
@@ -267,15 +408,39 @@ int main(int argc, char **argv)
         text_white = 231;
         back_green = 28;
     }
+    timing_phase("colors");
 
     bool continuing = true;
+    bool painted = false;
     int ch = 0;
 
+    /* while a refresh is due, getch() gives up now and then to look for it */
+    bool refreshing = args->refresh_path != NULL;
+    bool same = true;
+    const char *status = NULL;
+    if(refreshing) timeout(REFRESH_POLL_MS);
+
     while(continuing) {
         orange_banner("Choose an Ubuntu version to install");
         add_chooser(iso_info, iso_info->cur);
+        status_line(status);
         redrawwin(stdscr);
+        if(!painted) {
+            /* getch() would refresh anyway, do it here to time it */
+            refresh();
+            timing_phase("first_paint");
+            painted = true;
+        }
+        /* whether the choice drawn is the one a key acts on */
+        same = true;
         ch = getch();
+        if(ch != ERR) status = NULL;
+        if(refreshing && apply_refresh(args, policy, iso_info, &same)) {
+            refreshing = false;
+            timeout(-1);
+            /* there may be fewer choices than were drawn */
+            erase();
+        }
         switch(ch) {
             case KEY_DOWN:
                 choice_handle_event(args, iso_info, INCREASE);
@@ -287,6 +452,45 @@ int main(int argc, char **argv)
             case '\r':
             case '\n':
             case ' ':
+                /* only while waiting on a refresh can there be none */
+                if(!iso_info->len && !refreshing) break;
+                if(refreshing) {
+                    /* the snapshot may be out of date, so the choice waits
+                     * for the refresh and stands if it is the same image */
+                    status_line("Checking for newer images...");
+                    refresh();
+                    bool refreshed = false;
+                    for(int waited = 0; waited < REFRESH_WAIT_MS;
+                            waited += REFRESH_POLL_MS) {
+                        refreshed = apply_refresh(args, policy, iso_info,
+                                                  &same);
+                        if(refreshed) break;
+                        napms(REFRESH_POLL_MS);
+                    }
+                    flushinp();
+                    if(refreshed) {
+                        refreshing = false;
+                        timeout(-1);
+                        erase();
+                    } else if(!iso_info->len) {
+                        status = "No images yet, still checking";
+                        break;
+                    } else {
+                        /* the mirror is slow or unreachable, and the
+                         * snapshot will have to do */
+                        syslog(LOG_WARNING, "no refresh after %d ms, "
+                               "keeping the choice from the snapshot",
+                               REFRESH_WAIT_MS);
+                        status_line("No answer from the mirror, going "
+                                    "ahead with this image");
+                        refresh();
+                        napms(STATUS_HOLD_MS);
+                    }
+                }
+                if(!same || !iso_info->len) {
+                    status = "The images have changed, please choose again";
+                    break;
+                }
                 choice_handle_event(args, iso_info, SELECT);
                 continuing = false;
                 break;
@@ -295,7 +499,10 @@ int main(int argc, char **argv)
         }
     }
 
+    timing_report(args->timing_path);
+
     choices_free(iso_info);
+    policy_free(policy);
     args_free(args);
 
     return 0;
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "policy.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "json.h"
+
+policy_t *policy_create(void)
+{
+    policy_t *ret = calloc(sizeof(policy_t), 1);
+    if(!ret) return NULL;
+    ret->minimum_version = strdup(MINIMUM_UBUNTU_VERSION);
+    if(!ret->minimum_version) {
+        free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+void policy_free(policy_t *policy)
+{
+    if(!policy) return;
+    free(policy->minimum_version);
+    for(int i = 0; i < policy->num_series; i++) free(policy->series[i]);
+    for(int i = 0; i < policy->num_flavours; i++) free(policy->flavours[i]);
+    for(int i = 0; i < policy->num_prefer; i++) free(policy->prefer[i]);
+    free(policy);
+}
+
+/* split a comma separated value into list, false if it doesn't fit */
+bool parse_list(char *value, char **list, int *len)
+{
+    char *save = NULL;
+    for(char *tok = strtok_r(value, ",", &save); tok;
+            tok = strtok_r(NULL, ",", &save)) {
+        if(*len >= POLICY_MAX_LIST) return false;
+        list[(*len)++] = strdup(tok);
+        if(!list[*len - 1]) return false;
+    }
+    return true;
+}
+
+bool parse_order(char *value, policy_t *policy)
+{
+    const char *names[POLICY_KEY_COUNT] = {
+        [POLICY_KEY_VERSION] = "version",
+        [POLICY_KEY_LTS] = "lts",
+        [POLICY_KEY_FLAVOUR] = "flavour",
+        [POLICY_KEY_LABEL] = "label",
+    };
+
+    char *save = NULL;
+    for(char *tok = strtok_r(value, ",", &save); tok;
+            tok = strtok_r(NULL, ",", &save)) {
+        policy_order_t order = {.descending = *tok == '-'};
+        if(order.descending) tok++;
+        order.key = POLICY_KEY_COUNT;
+        for(int i = 0; i < POLICY_KEY_COUNT; i++) {
+            if(eq(tok, names[i])) order.key = i;
+        }
+        if(order.key == POLICY_KEY_COUNT) return false;
+        if(policy->num_order >= POLICY_KEY_COUNT) return false;
+        policy->order[policy->num_order++] = order;
+    }
+    return true;
+}
+
+bool parse_bool(const char *value, bool *ret)
+{
+    if(eq(value, "true") || eq(value, "yes") || eq(value, "1")) {
+        *ret = true;
+    } else if(eq(value, "false") || eq(value, "no") || eq(value, "0")) {
+        *ret = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_line(char *line, policy_t *policy)
+{
+    char *value = strchr(line, '=');
+    if(!value) return false;
+    *value++ = '\0';
+
+    if(eq(line, "minimum_version")) {
+        /* the floor from the kernel modules still applies */
+        if(lt(value, MINIMUM_UBUNTU_VERSION)) return false;
+        free(policy->minimum_version);
+        policy->minimum_version = strdup(value);
+        return policy->minimum_version != NULL;
+    } else if(eq(line, "series")) {
+        return parse_list(value, policy->series, &policy->num_series);
+    } else if(eq(line, "flavours")) {
+        return parse_list(value, policy->flavours, &policy->num_flavours);
+    } else if(eq(line, "lts_only")) {
+        return parse_bool(value, &policy->lts_only);
+    } else if(eq(line, "order")) {
+        return parse_order(value, policy);
+    } else if(eq(line, "prefer")) {
+        return parse_list(value, policy->prefer, &policy->num_prefer);
+    }
+    return false;
+}
+
+policy_t *policy_load(const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if(!f) {
+        syslog(LOG_ERR, "failed to open policy file [%s]: %m", filename);
+        return NULL;
+    }
+
+    policy_t *policy = policy_create();
+    char *line = NULL;
+    size_t size = 0;
+    int lineno = 0;
+    while(policy && getline(&line, &size, f) != -1) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if(line[0] == '#' || line[0] == '\0') continue;
+        if(!parse_line(line, policy)) {
+            fprintf(stderr, "%s:%d: invalid policy\n", filename, lineno);
+            policy_free(policy);
+            policy = NULL;
+        }
+    }
+    free(line);
+    fclose(f);
+    return policy;
+}
+
+bool in_list(char *const *list, int len, const char *value)
+{
+    for(int i = 0; i < len; i++) {
+        if(eq(list[i], value)) return true;
+    }
+    return false;
+}
+
+bool is_lts(const char *release_title)
+{
+    return release_title && strstr(release_title, "LTS");
+}
+
+bool policy_allows(const policy_t *policy, json_object *product)
+{
+    const char *title = str(get(product, "release_title"));
+    if(lt(title, policy ? policy->minimum_version : MINIMUM_UBUNTU_VERSION))
+        return false;
+    if(!policy) return true;
+
+    if(policy->num_series
+            && !in_list(policy->series, policy->num_series,
+                        str(get(product, "release")))) {
+        return false;
+    }
+    if(policy->num_flavours
+            && !in_list(policy->flavours, policy->num_flavours,
+                        str(get(product, "os")))) {
+        return false;
+    }
+    if(policy->lts_only && !is_lts(title)) return false;
+    return true;
+}
+
+int policy_source_rank(const policy_t *policy, const char *url)
+{
+    if(!policy || !url) return 0;
+    for(int i = 0; i < policy->num_prefer; i++) {
+        if(strncmp(url, policy->prefer[i], strlen(policy->prefer[i])) == 0)
+            return i;
+    }
+    return policy->num_prefer;
+}
+
+/* the keys of a choice, worked out once before sorting */
+typedef struct _sort_key_t
+{
+    iso_data_t *iso_data;
+    const policy_t *policy;
+    int flavour; /* position in the flavours list, or past its end */
+    bool lts;
+    int index; /* in the stream order, as the final tie break */
+} sort_key_t;
+
+int cmp_str(const char *a, const char *b)
+{
+    return strcmp(a ? a : "", b ? b : "");
+}
+
+int cmp_sort_key(const void *pa, const void *pb)
+{
+    const sort_key_t *a = pa, *b = pb;
+    const policy_t *policy = a->policy;
+
+    for(int i = 0; i < policy->num_order; i++) {
+        int rv = 0;
+        switch(policy->order[i].key) {
+            case POLICY_KEY_VERSION:
+                rv = cmp_str(a->iso_data->version, b->iso_data->version);
+                break;
+            case POLICY_KEY_LTS:
+                rv = a->lts - b->lts;
+                break;
+            case POLICY_KEY_FLAVOUR:
+                rv = a->flavour - b->flavour;
+                if(!rv) rv = cmp_str(a->iso_data->os, b->iso_data->os);
+                break;
+            case POLICY_KEY_LABEL:
+                rv = cmp_str(a->iso_data->label, b->iso_data->label);
+                break;
+            default:
+                break;
+        }
+        if(rv) return policy->order[i].descending ? -rv : rv;
+    }
+    return a->index - b->index;
+}
+
+void policy_sort(const policy_t *policy, choices_t *choices)
+{
+    if(!policy || !policy->num_order || choices->len < 2) return;
+
+    sort_key_t *keys = calloc(sizeof(sort_key_t), choices->len);
+    if(!keys) return;
+    for(int i = 0; i < choices->len; i++) {
+        iso_data_t *iso_data = choices->values[i];
+        keys[i].iso_data = iso_data;
+        keys[i].policy = policy;
+        keys[i].flavour = policy->num_flavours;
+        for(int j = 0; j < policy->num_flavours; j++) {
+            if(eq(policy->flavours[j], iso_data->os)) {
+                keys[i].flavour = j;
+                break;
+            }
+        }
+        keys[i].lts = is_lts(iso_data->version);
+        keys[i].index = i;
+    }
+
+    qsort(keys, choices->len, sizeof(sort_key_t), cmp_sort_key);
+    for(int i = 0; i < choices->len; i++) {
+        choices->values[i] = keys[i].iso_data;
+    }
+    free(keys);
+}
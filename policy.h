@@ -0,0 +1,90 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include <json-c/json.h>
+
+#include "common.h"
+
+/* The way this mini.iso chainboots depends on PMEM kernel modules,
+ * and ISOs below 22.04.2 have kernels that don't have those modules.*/
+#define MINIMUM_UBUNTU_VERSION "22.04.2"
+
+#define POLICY_MAX_LIST 16
+
+/* what choices can be ordered by */
+typedef enum {
+    POLICY_KEY_VERSION, /* release_title, such as "22.04.2 LTS" */
+    POLICY_KEY_LTS, /* LTS releases after the others */
+    POLICY_KEY_FLAVOUR, /* in the order of the flavours list, else by os */
+    POLICY_KEY_LABEL,
+    POLICY_KEY_COUNT,
+} policy_key;
+
+typedef struct _policy_order_t
+{
+    policy_key key;
+    bool descending;
+} policy_order_t;
+
+/* Which products the menu offers, and in what order, per site.  Read from a
+ * file of key=value lines, where blank lines and those starting with '#' are
+ * ignored:
+ *
+ * minimum_version=22.04.2   no release_title below this, and never below
+ *                           MINIMUM_UBUNTU_VERSION
+ * series=jammy,noble        only these releases
+ * flavours=ubuntu-server    only these os values
+ * lts_only=true             only LTS releases
+ * order=flavour,-version    sort keys, '-' for descending, from version, lts,
+ *                           flavour and label
+ * prefer=https://mirror/    of the same image found in several streams, keep
+ *                           the url starting with the earliest of these
+ */
+typedef struct _policy_t
+{
+    char *minimum_version;
+    int num_series;
+    char *series[POLICY_MAX_LIST];
+    int num_flavours;
+    char *flavours[POLICY_MAX_LIST];
+    bool lts_only;
+    int num_order; /* 0 keeps the order of the streams */
+    policy_order_t order[POLICY_KEY_COUNT];
+    int num_prefer;
+    char *prefer[POLICY_MAX_LIST];
+} policy_t;
+
+policy_t *policy_create(void);
+policy_t *policy_load(const char *filename);
+void policy_free(policy_t *policy);
+
+/* whether the policy lets the menu offer this product; a NULL policy only
+ * enforces MINIMUM_UBUNTU_VERSION */
+bool policy_allows(const policy_t *policy, json_object *product);
+
+/* how preferred a url is as the source of an image, lower is better */
+int policy_source_rank(const policy_t *policy, const char *url);
+
+/* sort choices by the order of the policy, keeping the order of the streams
+ * among equals */
+void policy_sort(const policy_t *policy, choices_t *choices);
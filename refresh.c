@@ -0,0 +1,145 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "refresh.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "json.h"
+
+char **refresh_read_marker(const char *marker, int *num_streams)
+{
+    FILE *f = fopen(marker, "r");
+    if(!f) {
+        if(errno != ENOENT) {
+            syslog(LOG_ERR, "failed to open refresh marker [%s]: %m", marker);
+        }
+        return NULL;
+    }
+
+    int capacity = 4;
+    int num = 0;
+    char **streams = calloc(sizeof(char *), capacity + 1);
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    while(streams && (len = getline(&line, &size, f)) != -1) {
+        while(len > 0 && isspace((unsigned char)line[len - 1])) {
+            line[--len] = '\0';
+        }
+        if(len == 0) continue;
+        if(num == capacity) {
+            capacity *= 2;
+            char **grown = realloc(streams, sizeof(char *) * (capacity + 1));
+            if(!grown) {
+                refresh_free_streams(streams);
+                streams = NULL;
+                break;
+            }
+            streams = grown;
+        }
+        streams[num] = strdup(line);
+        streams[++num] = NULL;
+    }
+    free(line);
+    fclose(f);
+
+    if(!streams) {
+        syslog(LOG_ERR, "fatal: alloc failure");
+        exit(1);
+    }
+    *num_streams = num;
+    return streams;
+}
+
+void refresh_free_streams(char **streams)
+{
+    if(!streams) return;
+    for(int i = 0; streams[i]; i++) free(streams[i]);
+    free(streams);
+}
+
+bool iso_data_same_image(const iso_data_t *a, const iso_data_t *b)
+{
+    return eq(a->url, b->url) && eq(a->sha256sum, b->sha256sum)
+        && a->size == b->size;
+}
+
+/* length of the series at the start of a release_title, "22.04" of
+ * "22.04.3 LTS" */
+static size_t series_len(const char *version)
+{
+    size_t len = 0;
+    bool dot = false;
+    for(; version[len]; len++) {
+        if(version[len] == '.' && !dot) dot = true;
+        else if(!isdigit((unsigned char)version[len])) break;
+    }
+    return len;
+}
+
+static bool same_series(const iso_data_t *a, const iso_data_t *b)
+{
+    if(!a->os || !b->os || !a->version || !b->version) return false;
+    if(!eq(a->os, b->os)) return false;
+    size_t len = series_len(a->version);
+    return len > 0 && len == series_len(b->version)
+        && strncmp(a->version, b->version, len) == 0;
+}
+
+bool choices_refresh(choices_t *choices, choices_t *fresh)
+{
+    if(fresh->len == 0) {
+        choices_free(fresh);
+        return true;
+    }
+
+    const iso_data_t *selected = choices->len > 0
+        ? choices->values[choices->cur] : NULL;
+    int cur = -1;
+    for(int i = 0; selected && cur < 0 && i < fresh->len; i++) {
+        if(eq(fresh->values[i]->label, selected->label)) cur = i;
+    }
+    for(int i = 0; selected && cur < 0 && i < fresh->len; i++) {
+        if(same_series(fresh->values[i], selected)) cur = i;
+    }
+    bool same = cur >= 0
+        && iso_data_same_image(fresh->values[cur], selected);
+
+    /* swap the values, so that freeing fresh frees the old ones */
+    iso_data_t **values = choices->values;
+    int len = choices->len;
+    int capacity = choices->capacity;
+    choices->values = fresh->values;
+    choices->len = fresh->len;
+    choices->capacity = fresh->capacity;
+    choices->cur = cur >= 0 ? cur : 0;
+    fresh->values = values;
+    fresh->len = len;
+    fresh->capacity = capacity;
+    choices_free(fresh);
+
+    return same;
+}
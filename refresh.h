@@ -0,0 +1,48 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "common.h"
+
+/* The menu can be shown from a snapshot of the streams, built into the
+ * initramfs, while the live streams are fetched behind it.  Once fetching is
+ * done a marker file is written, of the paths of the streams fetched, one per
+ * line, and the menu swaps in the choices read from those.  An empty marker
+ * means none could be fetched, and the snapshot stays. */
+
+/* NULL while the marker does not exist, else the paths it lists, NULL
+ * terminated, with their number in num_streams.  Free with
+ * refresh_free_streams(). */
+char **refresh_read_marker(const char *marker, int *num_streams);
+void refresh_free_streams(char **streams);
+
+/* whether two choices are the same image, which a choice that was about to
+ * be made can go ahead with */
+bool iso_data_same_image(const iso_data_t *a, const iso_data_t *b);
+
+/* Replace the values of choices with those of fresh, which is freed.  The
+ * selection moves to the fresh choice with the label of the one selected,
+ * failing that to one of the same flavour and series, such as 22.04 for a
+ * 22.04.3 that became 22.04.4, and failing that to the first.  Returns
+ * whether the selected choice is the same image as before.  If fresh has no
+ * values the choices are kept as they are. */
+bool choices_refresh(choices_t *choices, choices_t *fresh);
@@ -0,0 +1,878 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "scan.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define HAVE_NEON 1
+#endif
+
+#define BLOCK_SIZE 64
+/* bytes indexed at a time, and so the most tokens a batch can have */
+#define BATCH_SIZE (1024 * BLOCK_SIZE)
+/* json-c's default nesting limit, far deeper than any stream */
+#define MAX_DEPTH 32
+
+/* The bits of one block of input matching each character class, bit n
+ * being byte n. */
+typedef struct _masks_t
+{
+    uint64_t backslash;
+    uint64_t quote;
+    uint64_t op;    /* { } [ ] : , */
+    uint64_t space; /* space, tab, newline, carriage return */
+} masks_t;
+
+/* state carried from one block to the next */
+typedef struct _carry_t
+{
+    uint64_t escaped;   /* 1 if the first byte of the next block is escaped */
+    uint64_t in_string; /* all ones if the block ended inside a string */
+    uint64_t scalar;    /* 1 if the block ended inside a scalar */
+} carry_t;
+
+typedef size_t (*index_fn)(const uint8_t *buf, size_t from, size_t to,
+                           carry_t *carry, uint32_t *tokens);
+
+static inline uint64_t prefix_xor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+/* The bytes following an odd length run of backslashes, which are the
+ * escaped ones.  Runs starting on an even bit end on an odd bit exactly when
+ * they are of odd length, and the other way around, which adding the run
+ * starts to the runs finds for all of them at once. */
+static inline uint64_t find_escaped(uint64_t backslash, uint64_t *carry)
+{
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    const uint64_t odd_bits = ~even_bits;
+
+    /* an escaped backslash does not start a run */
+    uint64_t escaped_first = *carry;
+    backslash &= ~escaped_first;
+
+    uint64_t starts = backslash & ~(backslash << 1);
+    uint64_t even_starts = starts & even_bits;
+    uint64_t odd_starts = starts & odd_bits;
+
+    uint64_t even_ends = (backslash + even_starts) & ~backslash;
+    uint64_t odd_ends;
+    *carry = __builtin_add_overflow(backslash, odd_starts, &odd_ends);
+    odd_ends &= ~backslash;
+
+    return escaped_first | (even_ends & odd_bits) | (odd_ends & even_bits);
+}
+
+/* Append the offsets of the tokens in a block: structural characters and
+ * quotes outside strings, and the first byte of each scalar.  A string is
+ * then the bytes between two quote tokens, and a scalar runs up to the next
+ * space or structural character. */
+static inline size_t index_block(const masks_t *masks, carry_t *carry,
+                                 uint32_t base, uint32_t *tokens)
+{
+    uint64_t escaped = find_escaped(masks->backslash, &carry->escaped);
+    uint64_t quote = masks->quote & ~escaped;
+    /* set from an opening quote up to, but not including, its closing
+     * quote */
+    uint64_t in_string = prefix_xor(quote) ^ carry->in_string;
+    carry->in_string = (uint64_t)((int64_t)in_string >> 63);
+
+    uint64_t scalar = ~(masks->op | masks->space | quote | in_string);
+    uint64_t starts = scalar & ~(scalar << 1 | carry->scalar);
+    carry->scalar = scalar >> 63;
+
+    uint64_t bits = (masks->op & ~in_string) | quote | starts;
+    size_t count = 0;
+    while(bits) {
+        tokens[count++] = base + __builtin_ctzll(bits);
+        bits &= bits - 1;
+    }
+    return count;
+}
+
+/* The input is padded with spaces to whole blocks, so each kernel only
+ * deals with those.  Returns the number of tokens in buf[from:to]. */
+#define INDEX_BLOCKS(classify, buf, from, to, carry, tokens)                \
+    do {                                                                    \
+        size_t count = 0;                                                   \
+        for(size_t at = (from); at < (to); at += BLOCK_SIZE) {              \
+            masks_t masks;                                                  \
+            classify((buf) + at, &masks);                                   \
+            count += index_block(&masks, (carry), at, (tokens) + count);    \
+        }                                                                   \
+        return count;                                                       \
+    } while(0)
+
+#ifdef HAVE_X86
+__attribute__((target("sse2")))
+static inline void classify_sse2(const uint8_t *block, masks_t *masks)
+{
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i quote = _mm_set1_epi8('"');
+    /* '[' and ']' are '{' and '}' without the 0x20 bit */
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    *masks = (masks_t){};
+    for(int i = 0; i < 4; i++) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+        __m128i folded = _mm_or_si128(in, lower);
+        __m128i op = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(folded, open),
+                             _mm_cmpeq_epi8(folded, close)),
+                _mm_or_si128(_mm_cmpeq_epi8(in, colon),
+                             _mm_cmpeq_epi8(in, comma)));
+        __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(in, space),
+                             _mm_cmpeq_epi8(in, tab)),
+                _mm_or_si128(_mm_cmpeq_epi8(in, newline),
+                             _mm_cmpeq_epi8(in, cr)));
+        int shift = 16 * i;
+        masks->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(in, backslash)) << shift;
+        masks->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(in, quote)) << shift;
+        masks->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << shift;
+        masks->space |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << shift;
+    }
+}
+
+__attribute__((target("sse2")))
+static size_t index_sse2(const uint8_t *buf, size_t from, size_t to,
+                         carry_t *carry, uint32_t *tokens)
+{
+    INDEX_BLOCKS(classify_sse2, buf, from, to, carry, tokens);
+}
+
+static bool supported_sse2(void)
+{
+    return __builtin_cpu_supports("sse2");
+}
+
+__attribute__((target("avx2")))
+static inline void classify_avx2(const uint8_t *block, masks_t *masks)
+{
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i lower = _mm256_set1_epi8(0x20);
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+
+    *masks = (masks_t){};
+    for(int i = 0; i < 2; i++) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)(block + 32 * i));
+        __m256i folded = _mm256_or_si256(in, lower);
+        __m256i op = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(folded, open),
+                                _mm256_cmpeq_epi8(folded, close)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(in, colon),
+                                _mm256_cmpeq_epi8(in, comma)));
+        __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(in, space),
+                                _mm256_cmpeq_epi8(in, tab)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(in, newline),
+                                _mm256_cmpeq_epi8(in, cr)));
+        int shift = 32 * i;
+        masks->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(in, backslash)) << shift;
+        masks->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(in, quote)) << shift;
+        masks->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << shift;
+        masks->space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws)
+                << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+static size_t index_avx2(const uint8_t *buf, size_t from, size_t to,
+                         carry_t *carry, uint32_t *tokens)
+{
+    INDEX_BLOCKS(classify_avx2, buf, from, to, carry, tokens);
+}
+
+static bool supported_avx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#ifdef HAVE_NEON
+/* the NEON equivalent of movemask, for four compare results at once */
+static inline uint64_t bitmask_neon(uint8x16_t v0, uint8x16_t v1,
+                                    uint8x16_t v2, uint8x16_t v3)
+{
+    const uint8x16_t bits = {
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+    };
+    uint8x16_t sum0 = vpaddq_u8(vandq_u8(v0, bits), vandq_u8(v1, bits));
+    uint8x16_t sum1 = vpaddq_u8(vandq_u8(v2, bits), vandq_u8(v3, bits));
+    sum0 = vpaddq_u8(sum0, sum1);
+    sum0 = vpaddq_u8(sum0, sum0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+}
+
+static inline void classify_neon(const uint8_t *block, masks_t *masks)
+{
+    const uint8x16_t lower = vdupq_n_u8(0x20);
+    uint8x16_t backslash[4], quote[4], op[4], ws[4];
+
+    for(int i = 0; i < 4; i++) {
+        uint8x16_t in = vld1q_u8(block + 16 * i);
+        uint8x16_t folded = vorrq_u8(in, lower);
+        backslash[i] = vceqq_u8(in, vdupq_n_u8('\\'));
+        quote[i] = vceqq_u8(in, vdupq_n_u8('"'));
+        op[i] = vorrq_u8(
+                vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')),
+                         vceqq_u8(folded, vdupq_n_u8('}'))),
+                vorrq_u8(vceqq_u8(in, vdupq_n_u8(':')),
+                         vceqq_u8(in, vdupq_n_u8(','))));
+        ws[i] = vorrq_u8(
+                vorrq_u8(vceqq_u8(in, vdupq_n_u8(' ')),
+                         vceqq_u8(in, vdupq_n_u8('\t'))),
+                vorrq_u8(vceqq_u8(in, vdupq_n_u8('\n')),
+                         vceqq_u8(in, vdupq_n_u8('\r'))));
+    }
+    masks->backslash = bitmask_neon(backslash[0], backslash[1],
+                                    backslash[2], backslash[3]);
+    masks->quote = bitmask_neon(quote[0], quote[1], quote[2], quote[3]);
+    masks->op = bitmask_neon(op[0], op[1], op[2], op[3]);
+    masks->space = bitmask_neon(ws[0], ws[1], ws[2], ws[3]);
+}
+
+static size_t index_neon(const uint8_t *buf, size_t from, size_t to,
+                         carry_t *carry, uint32_t *tokens)
+{
+    INDEX_BLOCKS(classify_neon, buf, from, to, carry, tokens);
+}
+
+static bool supported_neon(void)
+{
+    return getauxval(AT_HWCAP) & HWCAP_ASIMD;
+}
+#endif
+
+typedef struct _scan_kernel_t
+{
+    const char *name;
+    bool (*supported)(void);
+    index_fn index;
+} scan_kernel_t;
+
+/* in order of preference */
+static const scan_kernel_t kernels[] = {
+#ifdef HAVE_X86
+    {"avx2", supported_avx2, index_avx2},
+    {"sse2", supported_sse2, index_sse2},
+#endif
+#ifdef HAVE_NEON
+    {"neon", supported_neon, index_neon},
+#endif
+    {} /* must be last */
+};
+
+static const scan_kernel_t *kernel;
+
+static const scan_kernel_t *get_kernel(void)
+{
+    if(kernel) return kernel;
+    for(int i = 0; kernels[i].name; i++) {
+        if(kernels[i].supported()) {
+            kernel = &kernels[i];
+            break;
+        }
+    }
+    return kernel;
+}
+
+const char *scan_kernel_name(void)
+{
+    return get_kernel() ? kernel->name : NULL;
+}
+
+bool scan_use_kernel(const char *name)
+{
+    for(int i = 0; name && kernels[i].name; i++) {
+        if(strcmp(name, kernels[i].name) == 0) {
+            if(!kernels[i].supported()) return false;
+            kernel = &kernels[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/* What to build of an object: the keys to keep, and for each what to keep
+ * of its value if that is an object too. */
+typedef struct _field_t
+{
+    const char *key;
+    bool any; /* matches every key */
+    const struct _field_t *fields; /* NULL keeps all of the value */
+} field_t;
+
+static const field_t item_fields[] = {
+    {"ftype"}, {"path"}, {"sha256"}, {"size"},
+    {} /* must be last */
+};
+
+static const field_t items_fields[] = {
+    {"iso", .fields = item_fields},
+    {} /* must be last */
+};
+
+static const field_t version_fields[] = {
+    {"items", .fields = items_fields},
+    {} /* must be last */
+};
+
+static const field_t versions_fields[] = {
+    {.any = true, .fields = version_fields},
+    {} /* must be last */
+};
+
+/* the keys of prune_product(), which policy_allows() also reads */
+static const field_t product_fields[] = {
+    {"arch"}, {"os"}, {"image_type"}, {"release"}, {"release_codename"},
+    {"release_title"}, {"version"},
+    {"versions", .fields = versions_fields},
+    {} /* must be last */
+};
+
+static const field_t products_fields[] = {
+    {.any = true, .fields = product_fields},
+    {} /* must be last */
+};
+
+/* the keys of prune_stream() */
+static const field_t root_fields[] = {
+    {"content_id"}, {"datatype"}, {"format"}, {"updated"},
+    {"products", .fields = products_fields},
+    {} /* must be last */
+};
+
+static const field_t *find_field(const field_t *fields, const char *key,
+                                 size_t len)
+{
+    for(int i = 0; fields[i].key || fields[i].any; i++) {
+        if(fields[i].any) return &fields[i];
+        if(strlen(fields[i].key) == len
+                && memcmp(fields[i].key, key, len) == 0) {
+            return &fields[i];
+        }
+    }
+    return NULL;
+}
+
+/* The tokens are indexed a batch at a time as the walk reaches them, which
+ * keeps them in cache and their memory bounded. */
+typedef struct _scan_t
+{
+    const char *buf;
+    size_t len;     /* padded to whole blocks */
+    size_t indexed; /* how much of buf the tokens so far cover */
+    carry_t carry;
+    index_fn index;
+    uint32_t tokens[BATCH_SIZE];
+    size_t num_tokens;
+    size_t pos;
+    bool failed;
+} scan_t;
+
+static bool index_batch(scan_t *scan)
+{
+    while(scan->pos >= scan->num_tokens && scan->indexed < scan->len) {
+        size_t to = scan->indexed + BATCH_SIZE;
+        if(to > scan->len) to = scan->len;
+        scan->num_tokens = scan->index((const uint8_t *)scan->buf,
+                                       scan->indexed, to, &scan->carry,
+                                       scan->tokens);
+        scan->indexed = to;
+        scan->pos = 0;
+    }
+    return scan->pos < scan->num_tokens;
+}
+
+/* whether there is a token at pos, indexing more of the input if needed */
+static inline bool refill(scan_t *scan)
+{
+    return scan->pos < scan->num_tokens || index_batch(scan);
+}
+
+static inline char peek(scan_t *scan)
+{
+    if(!refill(scan)) return '\0';
+    return scan->buf[scan->tokens[scan->pos]];
+}
+
+static int hex4(const char *src)
+{
+    int ret = 0;
+    for(int i = 0; i < 4; i++) {
+        char c = src[i];
+        ret <<= 4;
+        if(c >= '0' && c <= '9') ret |= c - '0';
+        else if(c >= 'a' && c <= 'f') ret |= c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F') ret |= c - 'A' + 10;
+        else return -1;
+    }
+    return ret;
+}
+
+static char *put_utf8(char *out, int cp)
+{
+    if(cp < 0x80) {
+        *out++ = cp;
+    } else if(cp < 0x800) {
+        *out++ = 0xc0 | cp >> 6;
+        *out++ = 0x80 | (cp & 0x3f);
+    } else if(cp < 0x10000) {
+        *out++ = 0xe0 | cp >> 12;
+        *out++ = 0x80 | (cp >> 6 & 0x3f);
+        *out++ = 0x80 | (cp & 0x3f);
+    } else {
+        *out++ = 0xf0 | cp >> 18;
+        *out++ = 0x80 | (cp >> 12 & 0x3f);
+        *out++ = 0x80 | (cp >> 6 & 0x3f);
+        *out++ = 0x80 | (cp & 0x3f);
+    }
+    return out;
+}
+
+/* Unescape the len bytes at src into dst, which is never longer.  Returns
+ * the length written, or -1 for an invalid escape.  Unpaired surrogates
+ * become U+FFFD, as json-c does. */
+static ssize_t unescape(const char *src, size_t len, char *dst)
+{
+    const char *end = src + len;
+    char *out = dst;
+    while(src < end) {
+        const char *bs = memchr(src, '\\', end - src);
+        size_t plain = (bs ? bs : end) - src;
+        memcpy(out, src, plain);
+        out += plain;
+        src += plain;
+        if(!bs) break;
+
+        /* an escaped closing quote would not have ended the string, so
+         * there is always a byte after the backslash */
+        src++;
+        switch(*src++) {
+            case '"': *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/': *out++ = '/'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                int cp = end - src >= 4 ? hex4(src) : -1;
+                if(cp < 0) return -1;
+                src += 4;
+                if(cp >= 0xd800 && cp < 0xdc00) {
+                    int low = end - src >= 6 && src[0] == '\\'
+                            && src[1] == 'u' ? hex4(src + 2) : -1;
+                    if(low >= 0xdc00 && low < 0xe000) {
+                        cp = 0x10000 + ((cp - 0xd800) << 10)
+                                + (low - 0xdc00);
+                        src += 6;
+                    } else {
+                        cp = 0xfffd;
+                    }
+                } else if(cp >= 0xdc00 && cp < 0xe000) {
+                    cp = 0xfffd;
+                }
+                out = put_utf8(out, cp);
+                break;
+            }
+            default: return -1;
+        }
+    }
+    return out - dst;
+}
+
+static bool is_number(const char *src, size_t len)
+{
+    const char *end = src + len;
+    if(src < end && *src == '-') src++;
+    if(src == end) return false;
+    if(*src == '0') {
+        src++;
+    } else {
+        if(*src < '1' || *src > '9') return false;
+        while(src < end && *src >= '0' && *src <= '9') src++;
+    }
+    if(src < end && *src == '.') {
+        const char *digits = ++src;
+        while(src < end && *src >= '0' && *src <= '9') src++;
+        if(src == digits) return false;
+    }
+    if(src < end && (*src == 'e' || *src == 'E')) {
+        src++;
+        if(src < end && (*src == '+' || *src == '-')) src++;
+        const char *digits = src;
+        while(src < end && *src >= '0' && *src <= '9') src++;
+        if(src == digits) return false;
+    }
+    return src == end;
+}
+
+static json_object *parse_scalar(scan_t *scan, uint32_t at)
+{
+    const char *src = scan->buf + at;
+    size_t len = strcspn(src, " \t\n\r{}[]:,\"");
+
+    /* a null is kept as NULL, which is not a failure */
+    if(len == 4 && memcmp(src, "null", 4) == 0) return NULL;
+    if(len == 4 && memcmp(src, "true", 4) == 0) {
+        return json_object_new_boolean(1);
+    }
+    if(len == 5 && memcmp(src, "false", 5) == 0) {
+        return json_object_new_boolean(0);
+    }
+    if(!is_number(src, len)) {
+        scan->failed = true;
+        return NULL;
+    }
+
+    /* the scalar is followed by a delimiter, so these stop there */
+    json_object *ret = NULL;
+    errno = 0;
+    if(strcspn(src, ".eE") >= len) {
+        long long val = strtoll(src, NULL, 10);
+        if(!errno) ret = json_object_new_int64(val);
+    } else {
+        double val = strtod(src, NULL);
+        if(!errno) ret = json_object_new_double(val);
+    }
+    if(!ret) scan->failed = true;
+    return ret;
+}
+
+/* Skip a value that is not kept, whose first token was just consumed.
+ * Only its nesting is checked, one bit per level on a stack of whether that
+ * is an object. */
+static bool skip_value(scan_t *scan, char first, int depth)
+{
+    switch(first) {
+        case '"':
+            if(peek(scan) != '"') return false;
+            scan->pos++;
+            return true;
+        case '{':
+        case '[':
+            break;
+        case '}':
+        case ']':
+        case ':':
+        case ',':
+        case '\0':
+            return false;
+        default:
+            return true;
+    }
+
+    uint64_t stack = first == '{';
+    int level = 1;
+    while(level) {
+        if(!refill(scan)) return false;
+        char c = scan->buf[scan->tokens[scan->pos++]];
+        switch(c) {
+            case '{':
+            case '[':
+                if(depth + ++level > MAX_DEPTH) return false;
+                stack = stack << 1 | (c == '{');
+                break;
+            case '}':
+            case ']':
+                if((stack & 1) != (c == '}')) return false;
+                stack >>= 1;
+                level--;
+                break;
+            case '"':
+                if(peek(scan) != '"') return false;
+                scan->pos++;
+                break;
+        }
+    }
+    return true;
+}
+
+static json_object *parse_value(scan_t *scan, const field_t *fields,
+                                int depth);
+
+static json_object *parse_array(scan_t *scan, int depth)
+{
+    json_object *arr = json_object_new_array();
+    if(!arr) goto fail;
+
+    if(peek(scan) == ']') {
+        scan->pos++;
+        return arr;
+    }
+    for(;;) {
+        json_object *val = parse_value(scan, NULL, depth + 1);
+        if(scan->failed) goto fail;
+        if(json_object_array_add(arr, val) != 0) {
+            json_object_put(val);
+            goto fail;
+        }
+        char c = peek(scan);
+        scan->pos++;
+        if(c == ']') return arr;
+        if(c != ',') goto fail;
+    }
+
+fail:
+    scan->failed = true;
+    json_object_put(arr);
+    return NULL;
+}
+
+static json_object *parse_object(scan_t *scan, const field_t *fields,
+                                 int depth)
+{
+    json_object *obj = json_object_new_object();
+    if(!obj) goto fail;
+
+    if(peek(scan) == '}') {
+        scan->pos++;
+        return obj;
+    }
+    for(;;) {
+        if(peek(scan) != '"') goto fail;
+        uint32_t open = scan->tokens[scan->pos++];
+        if(peek(scan) != '"') goto fail;
+        uint32_t close = scan->tokens[scan->pos++];
+        if(peek(scan) != ':') goto fail;
+        scan->pos++;
+
+        const char *raw = scan->buf + open + 1;
+        size_t len = close - open - 1;
+        char *key = NULL;
+        if(memchr(raw, '\\', len)) {
+            key = malloc(len + 1);
+            ssize_t key_len = key ? unescape(raw, len, key) : -1;
+            if(key_len < 0) {
+                free(key);
+                goto fail;
+            }
+            key[key_len] = '\0';
+            raw = key;
+            len = key_len;
+        }
+
+        /* without a field list, all of the object is kept */
+        const field_t *field = fields ? find_field(fields, raw, len) : NULL;
+        if(fields && !field) {
+            free(key);
+            if(!refill(scan)) goto fail;
+            char first = scan->buf[scan->tokens[scan->pos++]];
+            if(!skip_value(scan, first, depth + 1)) goto fail;
+        } else {
+            json_object *val = parse_value(scan, field ? field->fields : NULL,
+                                           depth + 1);
+            if(!scan->failed && !key) key = strndup(raw, len);
+            if(scan->failed || !key
+                    || json_object_object_add(obj, key, val) != 0) {
+                free(key);
+                json_object_put(val);
+                goto fail;
+            }
+            free(key);
+        }
+
+        char c = peek(scan);
+        scan->pos++;
+        if(c == '}') return obj;
+        if(c != ',') goto fail;
+    }
+
+fail:
+    scan->failed = true;
+    json_object_put(obj);
+    return NULL;
+}
+
+static json_object *parse_string(scan_t *scan, uint32_t open)
+{
+    if(peek(scan) != '"') {
+        scan->failed = true;
+        return NULL;
+    }
+    uint32_t close = scan->tokens[scan->pos++];
+    const char *raw = scan->buf + open + 1;
+    size_t len = close - open - 1;
+
+    json_object *ret = NULL;
+    if(!memchr(raw, '\\', len)) {
+        ret = json_object_new_string_len(raw, len);
+    } else {
+        char *val = malloc(len + 1);
+        ssize_t val_len = val ? unescape(raw, len, val) : -1;
+        if(val_len >= 0) ret = json_object_new_string_len(val, val_len);
+        free(val);
+    }
+    if(!ret) scan->failed = true;
+    return ret;
+}
+
+/* The value at pos, keeping of objects only the given fields.  Failures set
+ * scan->failed, as NULL is also a JSON null. */
+static json_object *parse_value(scan_t *scan, const field_t *fields,
+                                int depth)
+{
+    if(depth > MAX_DEPTH || !refill(scan)) {
+        scan->failed = true;
+        return NULL;
+    }
+    uint32_t at = scan->tokens[scan->pos++];
+    switch(scan->buf[at]) {
+        case '{': return parse_object(scan, fields, depth);
+        case '[': return parse_array(scan, depth);
+        case '"': return parse_string(scan, at);
+        case '}':
+        case ']':
+        case ':':
+        case ',':
+            scan->failed = true;
+            return NULL;
+        default:
+            return parse_scalar(scan, at);
+    }
+}
+
+/* buf holds len bytes of input followed by at least a block of space, and
+ * is NUL terminated after that */
+static json_object *scan_padded(const char *buf, size_t len)
+{
+    const scan_kernel_t *cur = get_kernel();
+    if(!cur || len > UINT32_MAX - 2 * BLOCK_SIZE) return NULL;
+
+    scan_t *scan = malloc(sizeof(*scan));
+    if(!scan) return NULL;
+    *scan = (scan_t){
+        .buf = buf,
+        .len = (len + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE,
+        .index = cur->index,
+    };
+
+    /* an unterminated string leaves no closing quote token, so it fails the
+     * walk like anything else malformed */
+    json_object *root = parse_value(scan, root_fields, 0);
+    if(scan->failed || refill(scan)) {
+        json_object_put(root);
+        root = NULL;
+    }
+    free(scan);
+    return root;
+}
+
+json_object *scan_stream(const char *data, size_t len)
+{
+    char *buf = malloc(len + 2 * BLOCK_SIZE);
+    if(!buf) return NULL;
+    memcpy(buf, data, len);
+    memset(buf + len, ' ', 2 * BLOCK_SIZE - 1);
+    buf[len + 2 * BLOCK_SIZE - 1] = '\0';
+
+    json_object *ret = scan_padded(buf, len);
+    free(buf);
+    return ret;
+}
+
+json_object *scan_stream_file(const char *filename)
+{
+    if(!get_kernel()) return NULL;
+
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return NULL;
+
+    json_object *ret = NULL;
+    char *buf = NULL;
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size > UINT32_MAX) goto out;
+
+    size_t len = 0;
+    size_t cap = st.st_size;
+    buf = malloc(cap + 2 * BLOCK_SIZE);
+    if(!buf) goto out;
+    for(;;) {
+        if(len == cap) {
+            /* grown since the stat, or not a regular file */
+            char *prev = buf;
+            cap = cap ? cap * 2 : 65536;
+            buf = realloc(buf, cap + 2 * BLOCK_SIZE);
+            if(!buf) {
+                buf = prev;
+                goto out;
+            }
+        }
+        ssize_t got = read(fd, buf + len, cap - len);
+        if(got < 0 && errno == EINTR) continue;
+        if(got < 0) goto out;
+        if(got == 0) break;
+        len += got;
+    }
+    memset(buf + len, ' ', 2 * BLOCK_SIZE - 1);
+    buf[len + 2 * BLOCK_SIZE - 1] = '\0';
+    ret = scan_padded(buf, len);
+
+out:
+    free(buf);
+    close(fd);
+    return ret;
+}
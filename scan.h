@@ -0,0 +1,46 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <json-c/json.h>
+
+/* A simplestreams parser for the streams the menu reads, which are much
+ * larger than what it needs from them.  The structural characters and string
+ * boundaries of the whole document are found with SIMD compares first, then
+ * that index is walked to build json-c objects for just the keys read here:
+ * the top level descriptive keys, and of each product the keys
+ * prune_product() keeps and the iso item of each version.  Of everything
+ * else only the nesting is checked, and foreach_iso_item() would miss iso
+ * items under other keys.
+ *
+ * Returns NULL if the file is unreadable or malformed, or if no kernel is
+ * supported here, in which case json_object_from_file() is the fallback. */
+json_object *scan_stream_file(const char *filename);
+json_object *scan_stream(const char *data, size_t len);
+
+/* The index is built by the first kernel the CPU supports of "avx2",
+ * "sse2" and "neon".  scan_kernel_name() is NULL if there is none, and
+ * scan_use_kernel() overrides the choice, failing if the named kernel is
+ * unknown or unsupported here. */
+const char *scan_kernel_name(void);
+bool scan_use_kernel(const char *name);
@@ -0,0 +1,94 @@
+#!/bin/sh
+
+setup() {
+    load '/usr/lib/bats/bats-support/load.bash'
+    load '/usr/lib/bats/bats-assert/load.bash'
+
+    tmpdir=$(mktemp -d)
+    builddir="${BUILDDIR:-../../builddir}"
+}
+
+teardown() {
+    rm -rf "$tmpdir"
+}
+
+need_build() {
+    [ -x "$builddir/iso-chooser-menu" ] || skip "no build in $builddir"
+    command -v xorriso > /dev/null || skip "no xorriso"
+}
+
+@test "usage" {
+    run ./e2e
+    assert_failure
+    assert_output --partial "usage: e2e"
+}
+
+@test "invalid ISO size" {
+    run ./e2e --iso-size=none "$tmpdir"
+    assert_failure
+    assert_output "invalid ISO size"
+}
+
+@test "wget refuses anything off this machine" {
+    E2E_WGET=true run ./stubs/wget -q https://releases.ubuntu.com/
+    assert_failure
+    assert_output "refusing https://releases.ubuntu.com/"
+}
+
+@test "kexec needs something loaded" {
+    E2E_LOADED="$tmpdir/loaded" E2E_LOG="$tmpdir/log" run ./stubs/kexec --exec
+    assert_failure
+    assert_output "nothing loaded"
+}
+
+@test "kexec records what it loads" {
+    printf kernel > "$tmpdir/kernel"
+    printf initrd > "$tmpdir/initrd"
+    export E2E_LOADED="$tmpdir/loaded" E2E_LOG="$tmpdir/log" E2E_STAGE=s1
+    run ./stubs/kexec --command-line="a b ---" --load "$tmpdir/kernel" \
+        --initrd="$tmpdir/initrd"
+    assert_success
+    run ./stubs/kexec --exec
+    assert_success
+    run cat "$tmpdir/log"
+    assert_output "\
+load stage=s1 via=kexec kernel=6:$(printf kernel | sha256sum | cut -d' ' -f1) initrd=6:$(printf initrd | sha256sum | cut -d' ' -f1) command-line=a b ---
+exec stage=s1"
+}
+
+@test "both steps boot the ISO" {
+    need_build
+    run ./e2e --iso-size=32 "$builddir"
+    assert_success
+    assert_line --regexp "^stage name=s1 wall_ms=[0-9]+$"
+    assert_line --regexp "^stage name=s2 wall_ms=[0-9]+$"
+    assert_line --regexp "^point stage=s2 name=download ms=[0-9]+$"
+    assert_line --partial "load stage=s2 via=iso-kexec-prefetch "
+    assert_line "exec stage=s2"
+    assert_line "result=ok"
+}
+
+@test "a cached ISO is copied instead" {
+    need_build
+    ./e2e --iso-size=32 --cache="$tmpdir/cache" "$builddir"
+    run ./e2e --iso-size=32 --cache="$tmpdir/cache" "$builddir"
+    assert_success
+    assert_line --regexp "^point stage=s2 name=cache ms=[0-9]+$"
+    refute_line --regexp "^point stage=s2 name=download "
+    assert_line "result=ok"
+}
+
+@test "the menu is shown from a snapshot" {
+    need_build
+    run ./e2e --iso-size=32 --snapshot "$builddir"
+    assert_success
+    assert_line "result=ok"
+}
+
+@test "step 2 recovers by choosing again" {
+    need_build
+    run ./e2e --iso-size=32 --recover "$builddir"
+    assert_success
+    assert_line --regexp "^point stage=s2 name=recover ms=[0-9]+$"
+    assert_line "result=ok"
+}
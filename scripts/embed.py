@@ -0,0 +1,41 @@
+#!/usr/bin/python3
+
+# Write a C file defining the contents of files as byte arrays, so they can
+# be compiled into a program rather than installed next to it.
+# usage: embed.py <output.c> <name>=<path> [<name>=<path> ...]
+#
+# Each file becomes
+#   const uint8_t <name>[];
+#   const size_t <name>_len;
+
+import sys
+
+
+def embed(name, path):
+    with open(path, 'rb') as fp:
+        data = fp.read()
+    lines = [f'/* {path} */', f'const uint8_t {name}[] = {{']
+    for i in range(0, len(data), 12):
+        lines.append('    ' + ' '.join(f'0x{b:02x},' for b in data[i:i + 12]))
+    lines.append('};')
+    lines.append(f'const size_t {name}_len = {len(data)};')
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(f'usage: {sys.argv[0]} <output.c> <name>=<path> ...',
+              file=sys.stderr)
+        sys.exit(1)
+
+    parts = ['/* generated by embed.py, do not edit */\n',
+             '#include <stddef.h>\n#include <stdint.h>\n']
+    for arg in sys.argv[2:]:
+        name, _, path = arg.partition('=')
+        parts.append(embed(name, path))
+    with open(sys.argv[1], 'w') as fp:
+        fp.write('\n'.join(parts))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,129 @@
+#!/bin/sh
+
+setup() {
+    load '/usr/lib/bats/bats-support/load.bash'
+    load '/usr/lib/bats/bats-assert/load.bash'
+
+    tmpdir=$(mktemp -d)
+    cache="$tmpdir/cache"
+    mkdir "$cache"
+
+    sum_a=$(printf 'a%.0s' $(seq 64))
+    sum_b=$(printf 'b%.0s' $(seq 64))
+    sum_c=$(printf 'c%.0s' $(seq 64))
+}
+
+teardown() {
+    rm -rf "$tmpdir"
+}
+
+# cached <sha256> <size> <age in minutes>
+cached() {
+    head -c "$2" /dev/zero > "$cache/$1.iso"
+    touch -d "-$3 minutes" "$cache/$1.iso"
+}
+
+@test "usage" {
+    run ./iso-cache
+    assert_failure
+    assert_output "usage: iso-cache lookup|store|evict <dir> ..."
+}
+
+@test "lookup notices missing directory" {
+    run ./iso-cache lookup /not/exist "$sum_a" 10
+    assert_failure
+    assert_output "cache directory not found"
+}
+
+@test "lookup rejects bad sha256" {
+    run ./iso-cache lookup "$cache" ../../etc/passwd 10
+    assert_failure
+    assert_output "invalid sha256 ../../etc/passwd"
+}
+
+@test "lookup miss" {
+    run ./iso-cache lookup "$cache" "$sum_a" 10
+    assert_failure
+    assert_output "not cached"
+}
+
+@test "lookup hit marks recently used" {
+    cached "$sum_a" 10 60
+    run ./iso-cache lookup "$cache" "$sum_a" 10
+    assert_success
+    assert_output "$cache/$sum_a.iso"
+    run find "$cache" -name "$sum_a.iso" -mmin -1
+    assert_output "$cache/$sum_a.iso"
+}
+
+@test "lookup wrong size" {
+    cached "$sum_a" 10 1
+    run ./iso-cache lookup "$cache" "$sum_a" 11
+    assert_failure
+    assert_output "not cached"
+}
+
+@test "store" {
+    head -c 100 /dev/urandom > "$tmpdir/image"
+    head -c 50 /dev/zero >> "$tmpdir/image"
+    run ./iso-cache store "$cache" "$sum_a" 100 "$tmpdir/image" 1000
+    assert_success
+    run cmp -n 100 "$tmpdir/image" "$cache/$sum_a.iso"
+    assert_success
+    run stat -c %s "$cache/$sum_a.iso"
+    assert_output 100
+}
+
+@test "store short source" {
+    head -c 50 /dev/zero > "$tmpdir/image"
+    run ./iso-cache store "$cache" "$sum_a" 100 "$tmpdir/image" 1000
+    assert_failure
+    assert_output "failed to copy $tmpdir/image"
+    run ls "$cache"
+    assert_output ""
+}
+
+@test "store larger than cache" {
+    head -c 100 /dev/zero > "$tmpdir/image"
+    run ./iso-cache store "$cache" "$sum_a" 100 "$tmpdir/image" 99
+    assert_failure
+    assert_output "image larger than cache"
+}
+
+@test "store evicts least recently used" {
+    cached "$sum_a" 40 10
+    cached "$sum_b" 40 20
+    head -c 40 /dev/zero > "$tmpdir/image"
+    run ./iso-cache store "$cache" "$sum_c" 40 "$tmpdir/image" 100
+    assert_success
+    assert_output "evicted $sum_b.iso"
+    run ls "$cache"
+    assert_output "$sum_a.iso
+$sum_c.iso"
+}
+
+@test "store defaults to free space" {
+    head -c 40 /dev/zero > "$tmpdir/image"
+    run ./iso-cache store "$cache" "$sum_a" 40 "$tmpdir/image"
+    assert_success
+    assert [ -f "$cache/$sum_a.iso" ]
+}
+
+@test "evict" {
+    cached "$sum_a" 40 30
+    cached "$sum_b" 40 20
+    cached "$sum_c" 40 10
+    run ./iso-cache evict "$cache" 50
+    assert_success
+    assert_output "evicted $sum_a.iso
+evicted $sum_b.iso"
+    run ls "$cache"
+    assert_output "$sum_c.iso"
+}
+
+@test "evict within bounds" {
+    cached "$sum_a" 40 10
+    run ./iso-cache evict "$cache" 40
+    assert_success
+    assert_output ""
+}
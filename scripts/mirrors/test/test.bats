@@ -0,0 +1,83 @@
+#!/bin/sh
+
+setup() {
+    load '/usr/lib/bats/bats-support/load.bash'
+    load '/usr/lib/bats/bats-assert/load.bash'
+
+    tmpdir=$(mktemp -d)
+
+    # stands in for mirrors: the delay in seconds is taken from the host name,
+    # as in http://slow-0.5/x.iso, and a host named dead never answers
+    cat > "$tmpdir/wget" <<'STUB'
+#!/bin/sh
+for url; do :; done
+host="${url#http://}"
+host="${host%%/*}"
+case "$host" in
+    dead*)  exit 4;;
+    short*) head -c 100 /dev/zero; exit 0;;
+    slow-*) sleep "${host#slow-}";;
+esac
+head -c 1048576 /dev/zero
+STUB
+    chmod +x "$tmpdir/wget"
+    export WGET="$tmpdir/wget"
+    export PROBE_SIZE=65536
+}
+
+teardown() {
+    rm -rf "$tmpdir"
+}
+
+@test "needs a url" {
+    run ./rank_mirrors
+    assert_failure
+    assert_output "no urls"
+}
+
+@test "single mirror" {
+    run --separate-stderr ./rank_mirrors http://fast/a.iso
+    assert_success
+    assert_output "http://fast/a.iso"
+}
+
+@test "fastest first" {
+    run --separate-stderr ./rank_mirrors \
+        http://slow-1.0/a.iso http://fast/a.iso http://slow-0.3/a.iso
+    assert_success
+    assert_output "http://fast/a.iso
+http://slow-0.3/a.iso
+http://slow-1.0/a.iso"
+}
+
+@test "probes run concurrently" {
+    start=$(cut -d' ' -f1 /proc/uptime)
+    run --separate-stderr ./rank_mirrors \
+        http://slow-1.0/a.iso http://slow-1.0/b.iso http://slow-1.0/c.iso
+    end=$(cut -d' ' -f1 /proc/uptime)
+    assert_success
+    run awk "BEGIN { exit !($end - $start < 2.5) }"
+    assert_success
+}
+
+@test "drops failed mirrors" {
+    run --separate-stderr ./rank_mirrors \
+        http://dead/a.iso http://short/a.iso http://fast/a.iso
+    assert_success
+    assert_output "http://fast/a.iso"
+}
+
+@test "reports each mirror" {
+    run ./rank_mirrors http://dead/a.iso http://fast/a.iso
+    assert_success
+    assert_line "mirror http://dead/a.iso failed"
+    assert_line --regexp "^mirror http://fast/a.iso [0-9.]+s [0-9]+ KiB/s$"
+}
+
+@test "no mirror reachable" {
+    run ./rank_mirrors http://dead/a.iso http://dead/b.iso
+    assert_failure
+    assert_line "mirror http://dead/a.iso failed"
+    assert_line "mirror http://dead/b.iso failed"
+    assert_line "no mirror reachable"
+}
@@ -0,0 +1,62 @@
+#!/bin/sh
+
+setup() {
+    load '/usr/lib/bats/bats-support/load.bash'
+    load '/usr/lib/bats/bats-assert/load.bash'
+
+    tmpdir=$(mktemp -d)
+}
+
+teardown() {
+    rm -rf "$tmpdir"
+}
+
+@test "notices missing directory" {
+    run ./get_ip_directive /not/exist
+    assert_failure
+    assert_output "directory not found"
+}
+
+@test "no lease" {
+    run ./get_ip_directive "$tmpdir"
+    assert_failure
+    assert_output "no configured interface found"
+}
+
+@test "dhcp lease" {
+    cat > "$tmpdir/net-eth0.conf" <<LEASE
+DEVICE='eth0'
+PROTO='dhcp'
+IPV4ADDR='10.0.2.15'
+IPV4BROADCAST='10.0.2.255'
+IPV4NETMASK='255.255.255.0'
+IPV4GATEWAY='10.0.2.2'
+IPV4DNS0='10.0.2.3'
+IPV4DNS1='0.0.0.0'
+HOSTNAME='mini'
+DNSDOMAIN=''
+ROOTSERVER='10.0.2.2'
+DHCPLEASETIME='86400'
+LEASE
+    run ./get_ip_directive "$tmpdir"
+    assert_success
+    assert_output "ip=10.0.2.15::10.0.2.2:255.255.255.0:mini:eth0:off:10.0.2.3:"
+}
+
+@test "skips unconfigured interface" {
+    cat > "$tmpdir/net-eth0.conf" <<LEASE
+DEVICE='eth0'
+IPV4ADDR='0.0.0.0'
+LEASE
+    cat > "$tmpdir/net-eth1.conf" <<LEASE
+DEVICE='eth1'
+IPV4ADDR='192.168.1.20'
+IPV4NETMASK='255.255.255.0'
+IPV4GATEWAY='0.0.0.0'
+IPV4DNS0='192.168.1.1'
+IPV4DNS1='192.168.1.2'
+LEASE
+    run ./get_ip_directive "$tmpdir"
+    assert_success
+    assert_output "ip=192.168.1.20:::255.255.255.0::eth1:off:192.168.1.1:192.168.1.2"
+}
@@ -0,0 +1,130 @@
+#!/bin/sh
+
+setup() {
+    load '/usr/lib/bats/bats-support/load.bash'
+    load '/usr/lib/bats/bats-assert/load.bash'
+
+    tmpdir=$(mktemp -d)
+    builddir="${BUILDDIR:-../../builddir}"
+    export STREAM_INDEX="$builddir/stream-index"
+    [ -x "$STREAM_INDEX" ] || skip "no build in $builddir"
+
+    # a mirror with the two release streams, and one the menu doesn't read
+    www="$tmpdir/www"
+    mkdir -p "$www/streams/v1"
+    for stream in com.ubuntu.releases:ubuntu-server \
+            com.ubuntu.releases:ubuntu ; do
+        cp "../../test/data/$stream.json" "$www/streams/v1/"
+    done
+    index "$www" "Mon, 01 Jan 2024" "Mon, 01 Jan 2024"
+
+    ../e2e/serve_ranges "$www" > "$tmpdir/port" 2> /dev/null &
+    server=$!
+    for _ in $(seq 50) ; do
+        port="$(head -n 1 "$tmpdir/port")"
+        [ -n "$port" ] && break
+        sleep 0.1
+    done
+    mirror="http://127.0.0.1:$port"
+}
+
+teardown() {
+    if [ -n "$server" ] ; then
+        kill "$server"
+    fi
+    rm -rf "$tmpdir"
+}
+
+# write an index to <dir> with the updated times of the server and desktop
+# streams
+index() {
+    mkdir -p "$1/streams/v1"
+    cat > "$1/streams/v1/index.json" <<INDEX
+{
+  "format": "index:1.0",
+  "updated": "$2",
+  "index": {
+    "com.ubuntu.releases:ubuntu-server": {
+      "format": "products:1.0",
+      "path": "streams/v1/com.ubuntu.releases:ubuntu-server.json",
+      "updated": "$2"
+    },
+    "com.ubuntu.releases:ubuntu": {
+      "format": "products:1.0",
+      "path": "streams/v1/com.ubuntu.releases:ubuntu.json",
+      "updated": "$3"
+    },
+    "com.ubuntu.cloud:released:download": {
+      "format": "products:1.0",
+      "path": "streams/v1/com.ubuntu.cloud:released:download.json",
+      "updated": "$2"
+    }
+  }
+}
+INDEX
+}
+
+@test "usage" {
+    run ./fetch_streams "$tmpdir/out"
+    assert_failure
+    assert_output --partial "usage: fetch_streams"
+}
+
+@test "no index" {
+    run ./fetch_streams "$tmpdir/out" "$mirror/nowhere"
+    assert_failure
+    assert_output --partial "failed to fetch the index"
+}
+
+@test "not an index" {
+    run "$STREAM_INDEX" ../../test/data/com.ubuntu.releases:ubuntu.json
+    assert_failure
+    assert_output --partial "not a simplestreams index"
+}
+
+@test "fetches the streams the menu reads" {
+    run --separate-stderr ./fetch_streams "$tmpdir/out" "$mirror"
+    assert_success
+    assert_output "\
+$tmpdir/out/com.ubuntu.releases:ubuntu-server.json
+$tmpdir/out/com.ubuntu.releases:ubuntu.json"
+    cmp "$tmpdir/out/com.ubuntu.releases:ubuntu.json" \
+        "$www/streams/v1/com.ubuntu.releases:ubuntu.json"
+    [ -f "$tmpdir/out/index.json" ]
+}
+
+@test "nothing unchanged is fetched" {
+    mkdir -p "$tmpdir/cached"
+    cp "$www/streams/v1/index.json" "$tmpdir/cached/"
+    run --separate-stderr ./fetch_streams --cached="$tmpdir/cached" \
+        "$tmpdir/out" "$mirror"
+    assert_success
+    assert_output ""
+}
+
+@test "only updated streams are fetched" {
+    index "$tmpdir/cached" "Mon, 01 Jan 2024" "Sun, 31 Dec 2023"
+    mv "$tmpdir/cached/streams/v1/index.json" "$tmpdir/cached/"
+    run --separate-stderr ./fetch_streams --cached="$tmpdir/cached" \
+        "$tmpdir/out" "$mirror"
+    assert_success
+    assert_output "$tmpdir/out/com.ubuntu.releases:ubuntu.json"
+    [ ! -e "$tmpdir/out/com.ubuntu.releases:ubuntu-server.json" ]
+}
+
+@test "an unreadable cached index fetches everything" {
+    mkdir -p "$tmpdir/cached"
+    echo "{" > "$tmpdir/cached/index.json"
+    run --separate-stderr ./fetch_streams --cached="$tmpdir/cached" \
+        "$tmpdir/out" "$mirror"
+    assert_success
+    assert_line "$tmpdir/out/com.ubuntu.releases:ubuntu-server.json"
+    assert_line "$tmpdir/out/com.ubuntu.releases:ubuntu.json"
+}
+
+@test "a stream that can't be fetched fails" {
+    rm "$www/streams/v1/com.ubuntu.releases:ubuntu.json"
+    run --separate-stderr ./fetch_streams "$tmpdir/out" "$mirror"
+    assert_failure
+    [ ! -e "$tmpdir/out/com.ubuntu.releases:ubuntu.json" ]
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+
+setup() {
+    load '/usr/lib/bats/bats-support/load.bash'
+    load '/usr/lib/bats/bats-assert/load.bash'
+}
+
+@test "requires a timeline" {
+    run ./format_timeline
+    assert_failure
+    assert_output "no timeline"
+}
+
+@test "single stage" {
+    run ./format_timeline "s1.start:4.50,s1.menu:20.25"
+    assert_success
+    assert_output "\
+s1   start             4.50      4.50
+s1   menu             20.25     15.75
+total                 20.25"
+}
+
+@test "clock restarts with each stage" {
+    run ./format_timeline "s1.start:4.00,s1.kexec:30.00,s2.start:3.00,s2.kexec:63.50"
+    assert_success
+    assert_output "\
+s1   start             4.00      4.00
+s1   kexec            30.00     26.00
+s2   start             3.00      3.00
+s2   kexec            63.50     60.50
+total                 93.50"
+}
+
+@test "rejects malformed point" {
+    run ./format_timeline "s1.start:4.00,garbage"
+    assert_failure
+    assert_output "invalid timeline point garbage"
+}
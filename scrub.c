@@ -0,0 +1,153 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "scrub.h"
+
+#include <libgen.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+
+#include "json.h"
+
+/* the canonical path of the file in dir holding the item, or NULL if there
+ * is none */
+char *find_file(const char *dir, const char *path, const char *sha256,
+                bool *exact)
+{
+    char *copy = strdup(path);
+    if(!copy) return NULL;
+    char *candidates[] = {
+        saprintf("%s/%s", dir, path),
+        saprintf("%s/%s", dir, basename(copy)),
+        saprintf("%s/%s.iso", dir, sha256),
+    };
+    free(copy);
+
+    char *ret = NULL;
+    for(size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        struct stat st;
+        if(!ret && candidates[i] && stat(candidates[i], &st) == 0
+                && S_ISREG(st.st_mode)) {
+            ret = realpath(candidates[i], NULL);
+            *exact = i != 1;
+        }
+        free(candidates[i]);
+    }
+    return ret;
+}
+
+/* the entry for path, added if it is new, or NULL on allocation failure */
+scrub_file_t *get_file(scrub_match_t *match, char *path)
+{
+    for(int i = 0; i < match->len; i++) {
+        if(eq(match->files[i].path, path)) {
+            free(path);
+            return &match->files[i];
+        }
+    }
+
+    struct stat st;
+    if(stat(path, &st) == -1) st.st_size = -1;
+    scrub_file_t *files = realloc(match->files,
+                                  sizeof(scrub_file_t) * (match->len + 1));
+    if(!files) {
+        free(path);
+        return NULL;
+    }
+    match->files = files;
+    match->files[match->len] = (scrub_file_t){
+        .path = path,
+        .size = st.st_size,
+    };
+    return &match->files[match->len++];
+}
+
+bool scrub_add_item(void *ctx, const char *path, const char *sha256,
+                    int64_t size)
+{
+    scrub_match_t *match = ctx;
+
+    bool exact = false;
+    char *found = find_file(match->dir, path, sha256, &exact);
+    if(!found) return true;
+    scrub_file_t *file = get_file(match, found);
+    if(!file) return false;
+
+    /* the same image listed in several streams */
+    for(int i = 0; i < file->num_items; i++) {
+        if(eq(file->items[i].name, path) && eq(file->items[i].sha256, sha256)) {
+            return true;
+        }
+    }
+
+    scrub_item_t *items = realloc(file->items,
+                                  sizeof(scrub_item_t) * (file->num_items + 1));
+    if(!items) return false;
+    file->items = items;
+    scrub_item_t *item = &file->items[file->num_items];
+    *item = (scrub_item_t){
+        .name = strdup(path),
+        .sha256 = strdup(sha256),
+        .size = size,
+        .exact = exact,
+    };
+    if(!item->name || !item->sha256) {
+        free(item->name);
+        free(item->sha256);
+        return false;
+    }
+    file->num_items++;
+    return true;
+}
+
+const scrub_item_t *scrub_pick(const scrub_file_t *file, bool *sized)
+{
+    const scrub_item_t *ret = NULL;
+    *sized = false;
+    for(int i = 0; i < file->num_items; i++) {
+        const scrub_item_t *item = &file->items[i];
+        bool fits = item->size == file->size;
+        if(!ret || (fits && !*sized) || (fits == *sized && item->exact
+                                         && !ret->exact)) {
+            ret = item;
+            *sized = fits;
+        }
+    }
+    return ret;
+}
+
+void scrub_match_free(scrub_match_t *match)
+{
+    for(int i = 0; i < match->len; i++) {
+        scrub_file_t *file = &match->files[i];
+        for(int j = 0; j < file->num_items; j++) {
+            free(file->items[j].name);
+            free(file->items[j].sha256);
+        }
+        free(file->items);
+        free(file->path);
+    }
+    free(match->files);
+    match->files = NULL;
+    match->len = 0;
+}
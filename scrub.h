@@ -0,0 +1,61 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A stream item that maps to a file in the directory being scrubbed. */
+typedef struct _scrub_item_t
+{
+    char *name; /* path of the item in the stream */
+    char *sha256;
+    int64_t size;
+    bool exact; /* found under its own path or sha256, not its file name */
+} scrub_item_t;
+
+/* A file in the directory, with every item that maps to it. */
+typedef struct _scrub_file_t
+{
+    char *path; /* canonical, so each file is listed once */
+    int64_t size;
+    int num_items;
+    scrub_item_t *items;
+} scrub_file_t;
+
+typedef struct _scrub_match_t
+{
+    const char *dir;
+    int len;
+    scrub_file_t *files;
+} scrub_match_t;
+
+/* An iso_item_fn: look for the item in match->dir, at its path, then by its
+ * file name alone, then as <sha256>.iso, and add it to the file found.
+ * Items without a file are skipped.  Returns false on allocation failure. */
+bool scrub_add_item(void *ctx, const char *path, const char *sha256,
+                    int64_t size);
+
+/* The item to verify file against: one of the file's size, preferring an
+ * exact match, and *sized is set.  Failing that, the item the file was most
+ * likely meant to be, to report the mismatch against, and *sized is clear. */
+const scrub_item_t *scrub_pick(const scrub_file_t *file, bool *sized);
+
+void scrub_match_free(scrub_match_t *match);
@@ -0,0 +1,339 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "sha256.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define HAVE_SHANI 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define HAVE_ARMV8 1
+#endif
+
+typedef void (*blocks_fn)(uint32_t state[8], const uint8_t *data,
+                          size_t nblocks);
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static uint32_t ror(uint32_t x, int n)
+{
+    return x >> n | x << (32 - n);
+}
+
+static void blocks_portable(uint32_t state[8], const uint8_t *data,
+                            size_t nblocks)
+{
+    for(; nblocks > 0; nblocks--, data += SHA256_BLOCK_SIZE) {
+        uint32_t w[64];
+        for(int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)data[i * 4] << 24 | data[i * 4 + 1] << 16
+                 | data[i * 4 + 2] << 8 | data[i * 4 + 3];
+        }
+        for(int i = 16; i < 64; i++) {
+            uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18)
+                        ^ w[i - 15] >> 3;
+            uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19)
+                        ^ w[i - 2] >> 10;
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for(int i = 0; i < 64; i++) {
+            uint32_t s1 = ror(e, 6) ^ ror(e, 11) ^ ror(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + ch + K[i] + w[i];
+            uint32_t s0 = ror(a, 2) ^ ror(a, 13) ^ ror(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+static bool supported_portable(void)
+{
+    return true;
+}
+
+#ifdef HAVE_SHANI
+/* Each group of four rounds takes a message vector w[g], two rounds at a
+ * time through sha256rnds2, with the state kept as ABEF and CDGH. */
+__attribute__((target("sha,sse4.1")))
+static void blocks_shani(uint32_t state[8], const uint8_t *data,
+                         size_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                         0x0405060700010203ULL);
+
+    __m128i tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xb1); /* CDAB */
+    state1 = _mm_shuffle_epi32(state1, 0x1b); /* EFGH */
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); /* ABEF */
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0); /* CDGH */
+
+    for(; nblocks > 0; nblocks--, data += SHA256_BLOCK_SIZE) {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i w[4];
+
+        for(int g = 0; g < 16; g++) {
+            __m128i *cur = &w[g % 4];
+            if(g < 4) {
+                *cur = _mm_shuffle_epi8(
+                        _mm_loadu_si128((const __m128i *)(data + g * 16)),
+                        bswap);
+            } else {
+                __m128i w7 = _mm_alignr_epi8(w[(g - 1) % 4],
+                                             w[(g - 2) % 4], 4);
+                *cur = _mm_sha256msg1_epu32(*cur, w[(g - 3) % 4]);
+                *cur = _mm_add_epi32(*cur, w7);
+                *cur = _mm_sha256msg2_epu32(*cur, w[(g - 1) % 4]);
+            }
+
+            __m128i msg = _mm_add_epi32(
+                    *cur, _mm_loadu_si128((const __m128i *)&K[g * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            msg = _mm_shuffle_epi32(msg, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b); /* FEBA */
+    state1 = _mm_shuffle_epi32(state1, 0xb1); /* DCHG */
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0); /* DCBA */
+    state1 = _mm_alignr_epi8(state1, tmp, 8); /* HGFE */
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+static bool supported_shani(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    if(!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1)) return false;
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    return ebx & bit_SHA;
+}
+#endif
+
+#ifdef HAVE_ARMV8
+__attribute__((target("+crypto")))
+static void blocks_armv8(uint32_t state[8], const uint8_t *data,
+                         size_t nblocks)
+{
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    for(; nblocks > 0; nblocks--, data += SHA256_BLOCK_SIZE) {
+        uint32x4_t abcd = state0;
+        uint32x4_t efgh = state1;
+        uint32x4_t w[4];
+
+        for(int g = 0; g < 16; g++) {
+            uint32x4_t *cur = &w[g % 4];
+            if(g < 4) {
+                *cur = vreinterpretq_u32_u8(vrev32q_u8(
+                        vld1q_u8(data + g * 16)));
+            } else {
+                *cur = vsha256su0q_u32(*cur, w[(g - 3) % 4]);
+                *cur = vsha256su1q_u32(*cur, w[(g - 2) % 4],
+                                       w[(g - 1) % 4]);
+            }
+
+            uint32x4_t msg = vaddq_u32(*cur, vld1q_u32(&K[g * 4]));
+            uint32x4_t prev = state0;
+            state0 = vsha256hq_u32(state0, state1, msg);
+            state1 = vsha256h2q_u32(state1, prev, msg);
+        }
+
+        state0 = vaddq_u32(state0, abcd);
+        state1 = vaddq_u32(state1, efgh);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+static bool supported_armv8(void)
+{
+    return getauxval(AT_HWCAP) & HWCAP_SHA2;
+}
+#endif
+
+typedef struct _sha256_kernel_t
+{
+    const char *name;
+    bool (*supported)(void);
+    blocks_fn blocks;
+} sha256_kernel_t;
+
+/* in order of preference */
+static const sha256_kernel_t kernels[] = {
+#ifdef HAVE_SHANI
+    {"shani", supported_shani, blocks_shani},
+#endif
+#ifdef HAVE_ARMV8
+    {"armv8", supported_armv8, blocks_armv8},
+#endif
+    {"portable", supported_portable, blocks_portable},
+    {} /* must be last */
+};
+
+static const sha256_kernel_t *kernel;
+
+static const sha256_kernel_t *get_kernel(void)
+{
+    if(kernel) return kernel;
+    for(int i = 0; kernels[i].name; i++) {
+        if(kernels[i].supported()) {
+            kernel = &kernels[i];
+            break;
+        }
+    }
+    return kernel;
+}
+
+const char *sha256_kernel_name(void)
+{
+    return get_kernel()->name;
+}
+
+bool sha256_use_kernel(const char *name)
+{
+    for(int i = 0; kernels[i].name; i++) {
+        if(strcmp(name, kernels[i].name) == 0) {
+            if(!kernels[i].supported()) return false;
+            kernel = &kernels[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void sha256_init(sha256_t *ctx)
+{
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->len = 0;
+}
+
+void sha256_update(sha256_t *ctx, const void *data, size_t len)
+{
+    blocks_fn blocks = get_kernel()->blocks;
+    const uint8_t *cur = data;
+    size_t used = ctx->len % SHA256_BLOCK_SIZE;
+    ctx->len += len;
+
+    if(used) {
+        size_t fill = SHA256_BLOCK_SIZE - used;
+        if(len < fill) {
+            memcpy(ctx->buf + used, cur, len);
+            return;
+        }
+        memcpy(ctx->buf + used, cur, fill);
+        blocks(ctx->state, ctx->buf, 1);
+        cur += fill;
+        len -= fill;
+    }
+
+    size_t nblocks = len / SHA256_BLOCK_SIZE;
+    if(nblocks) {
+        blocks(ctx->state, cur, nblocks);
+        cur += nblocks * SHA256_BLOCK_SIZE;
+        len -= nblocks * SHA256_BLOCK_SIZE;
+    }
+    memcpy(ctx->buf, cur, len);
+}
+
+void sha256_final(sha256_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+    uint64_t bits = ctx->len * 8;
+    uint8_t pad[SHA256_BLOCK_SIZE * 2] = {0x80};
+    size_t used = ctx->len % SHA256_BLOCK_SIZE;
+    /* pad to 8 bytes short of a block, then the length in bits */
+    size_t pad_len = (used < 56 ? 56 : 120) - used;
+    for(int i = 0; i < 8; i++) {
+        pad[pad_len + i] = bits >> (56 - i * 8);
+    }
+    sha256_update(ctx, pad, pad_len + 8);
+
+    for(int i = 0; i < 8; i++) {
+        digest[i * 4] = ctx->state[i] >> 24;
+        digest[i * 4 + 1] = ctx->state[i] >> 16;
+        digest[i * 4 + 2] = ctx->state[i] >> 8;
+        digest[i * 4 + 3] = ctx->state[i];
+    }
+}
+
+void sha256_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char *out)
+{
+    static const char hex[] = "0123456789abcdef";
+    for(int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        out[i * 2] = hex[digest[i] >> 4];
+        out[i * 2 + 1] = hex[digest[i] & 0xf];
+    }
+    out[SHA256_DIGEST_SIZE * 2] = '\0';
+}
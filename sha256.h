@@ -0,0 +1,48 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+typedef struct _sha256_t
+{
+    uint32_t state[8];
+    uint64_t len; /* total bytes hashed */
+    uint8_t buf[SHA256_BLOCK_SIZE]; /* partial block awaiting more data */
+} sha256_t;
+
+void sha256_init(sha256_t *ctx);
+void sha256_update(sha256_t *ctx, const void *data, size_t len);
+void sha256_final(sha256_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/* digest as lowercase hex, out must hold 2 * SHA256_DIGEST_SIZE + 1 */
+void sha256_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char *out);
+
+/* The block function is picked at first use from what the CPU supports:
+ * "shani" (x86 SHA extensions), "armv8" (ARMv8 crypto extensions), then
+ * "portable".  sha256_use_kernel() overrides that, and fails if the named
+ * kernel is unknown or unsupported here. */
+const char *sha256_kernel_name(void);
+bool sha256_use_kernel(const char *name);
@@ -0,0 +1,292 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "sink.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#define CHUNK_SIZE (4 * 1024 * 1024)
+#define DIRECT_ALIGN 4096
+
+static const char *strategy_names[] = {
+    [SINK_AUTO] = "auto",
+    [SINK_MMAP] = "mmap",
+    [SINK_SPLICE] = "splice",
+    [SINK_DIRECT] = "direct",
+    [SINK_WRITE] = "write",
+};
+
+sink_strategy sink_strategy_from_name(const char *name)
+{
+    if(!name) return SINK_INVALID;
+    for(int i = 0; i < SINK_INVALID; i++) {
+        if(strcmp(name, strategy_names[i]) == 0) return i;
+    }
+    return SINK_INVALID;
+}
+
+const char *sink_strategy_name(sink_strategy strategy)
+{
+    if(strategy < 0 || strategy >= SINK_INVALID) return NULL;
+    return strategy_names[strategy];
+}
+
+static void report(sink_t *sink, int64_t written)
+{
+    if(sink->progress) sink->progress(sink, written);
+}
+
+/* Each strategy returns the bytes written or -1, and sets *unsupported if it
+ * failed before consuming any input, so the next one may be tried. */
+
+static ssize_t read_full(int fd, uint8_t *buf, size_t len)
+{
+    size_t done = 0;
+    while(done < len) {
+        ssize_t rv = read(fd, buf + done, len - done);
+        if(rv == -1 && errno == EINTR) continue;
+        if(rv == -1) return -1;
+        if(rv == 0) break;
+        done += rv;
+    }
+    return done;
+}
+
+static bool pwrite_full(int fd, const uint8_t *buf, size_t len, off_t offset)
+{
+    while(len > 0) {
+        ssize_t rv = pwrite(fd, buf, len, offset);
+        if(rv == -1 && errno == EINTR) continue;
+        if(rv <= 0) return false;
+        buf += rv;
+        len -= rv;
+        offset += rv;
+    }
+    return true;
+}
+
+static int64_t copy_mmap(int in_fd, int out_fd, sink_t *sink,
+                         bool *unsupported)
+{
+    if(sink->size < 0) {
+        *unsupported = true;
+        return -1;
+    }
+    if(sink->size == 0) return 0;
+
+    struct stat st;
+    if(fstat(out_fd, &st) == 0 && S_ISREG(st.st_mode)
+            && st.st_size < sink->offset + sink->size
+            && ftruncate(out_fd, sink->offset + sink->size) == -1) {
+        *unsupported = true;
+        return -1;
+    }
+
+    /* mappings start on a page boundary */
+    off_t start = sink->offset & ~(off_t)(sysconf(_SC_PAGESIZE) - 1);
+    size_t lead = sink->offset - start;
+    uint8_t *map = mmap(NULL, lead + sink->size, PROT_WRITE, MAP_SHARED,
+                        out_fd, start);
+    if(map == MAP_FAILED) {
+        *unsupported = true;
+        return -1;
+    }
+
+    int64_t done = 0;
+    while(done < sink->size) {
+        ssize_t rv = read_full(in_fd, map + lead + done,
+                               MIN(sink->size - done, CHUNK_SIZE));
+        if(rv <= 0) {
+            if(rv == -1) done = -1;
+            break;
+        }
+        done += rv;
+        report(sink, done);
+    }
+    /* anything past the expected size is an error */
+    uint8_t extra;
+    if(done == sink->size && read(in_fd, &extra, 1) != 0) done = -1;
+
+    msync(map, lead + sink->size, MS_SYNC);
+    munmap(map, lead + sink->size);
+    return done;
+}
+
+static int64_t copy_splice(int in_fd, int out_fd, sink_t *sink,
+                           bool *unsupported)
+{
+    loff_t offset = sink->offset;
+    for(;;) {
+        ssize_t rv = splice(in_fd, NULL, out_fd, &offset, CHUNK_SIZE,
+                            SPLICE_F_MOVE | SPLICE_F_MORE);
+        if(rv == -1 && errno == EINTR) continue;
+        if(rv == -1) {
+            *unsupported = offset == sink->offset && errno == EINVAL;
+            return -1;
+        }
+        if(rv == 0) return offset - sink->offset;
+        report(sink, offset - sink->offset);
+    }
+}
+
+static int64_t copy_buffered(int in_fd, int out_fd, sink_t *sink,
+                             bool direct)
+{
+    uint8_t *buf = NULL;
+    if(posix_memalign((void **)&buf, DIRECT_ALIGN, CHUNK_SIZE) != 0) {
+        return -1;
+    }
+
+    int64_t total = 0;
+    for(;;) {
+        ssize_t len = read_full(in_fd, buf, CHUNK_SIZE);
+        if(len <= 0) {
+            if(len == -1) total = -1;
+            break;
+        }
+
+        off_t offset = sink->offset + total;
+        size_t aligned = direct && offset % DIRECT_ALIGN == 0
+                       ? len & ~(DIRECT_ALIGN - 1) : 0;
+        if(aligned && !pwrite_full(out_fd, buf, aligned, offset)) {
+            if(errno != EINVAL) {
+                total = -1;
+                break;
+            }
+            /* the target refused direct writes after all */
+            aligned = 0;
+        }
+        if(aligned < (size_t)len) {
+            /* the unaligned tail, or everything once direct is dropped */
+            if(direct) {
+                fcntl(out_fd, F_SETFL,
+                      fcntl(out_fd, F_GETFL) & ~O_DIRECT);
+                direct = false;
+            }
+            if(!pwrite_full(out_fd, buf + aligned, len - aligned,
+                            offset + aligned)) {
+                total = -1;
+                break;
+            }
+        }
+        total += len;
+        report(sink, total);
+    }
+
+    free(buf);
+    return total;
+}
+
+/* Whether st is a device DAX character device, /dev/daxN.M, which maps
+ * straight onto the memory.  A pmem block device such as /dev/pmem0 is not:
+ * Linux 4.15 dropped DAX for raw block devices, so mapping one goes through
+ * the page cache like any other. */
+static bool is_devdax(const struct stat *st)
+{
+    if(!S_ISCHR(st->st_mode)) return false;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/subsystem",
+             major(st->st_rdev), minor(st->st_rdev));
+    char target[PATH_MAX];
+    ssize_t len = readlink(path, target, sizeof(target) - 1);
+    if(len == -1) return false;
+    target[len] = '\0';
+
+    const char *name = strrchr(target, '/');
+    return strcmp(name ? name + 1 : target, "dax") == 0;
+}
+
+static const sink_strategy auto_order[] = {
+    SINK_MMAP, SINK_SPLICE, SINK_DIRECT, SINK_WRITE, SINK_INVALID,
+};
+
+int64_t sink_copy(int in_fd, const char *path, sink_t *sink)
+{
+    sink_strategy strategy = sink->strategy;
+    sink->used = SINK_INVALID;
+    if(strategy < 0 || strategy >= SINK_INVALID || sink->offset < 0) {
+        return -1;
+    }
+
+    struct stat st = {};
+    bool exists = stat(path, &st) == 0;
+    bool regular = !exists || S_ISREG(st.st_mode);
+
+    for(int i = 0; auto_order[i] != SINK_INVALID; i++) {
+        sink_strategy cur = strategy == SINK_AUTO ? auto_order[i] : strategy;
+        /* anywhere but device DAX, mapping means the page cache, which is
+         * no better than splice */
+        if(strategy == SINK_AUTO && cur == SINK_MMAP && !is_devdax(&st)) {
+            continue;
+        }
+
+        int flags = (cur == SINK_MMAP ? O_RDWR : O_WRONLY) | O_CREAT
+                  | O_CLOEXEC | (cur == SINK_DIRECT ? O_DIRECT : 0);
+        int out_fd = open(path, flags, 0644);
+        if(out_fd == -1) {
+            if(cur == SINK_DIRECT && errno == EINVAL
+                    && strategy == SINK_AUTO) {
+                continue;
+            }
+            perror(path);
+            return -1;
+        }
+
+        bool unsupported = false;
+        int64_t written = -1;
+        switch(cur) {
+            case SINK_MMAP:
+                written = copy_mmap(in_fd, out_fd, sink, &unsupported);
+                break;
+            case SINK_SPLICE:
+                written = copy_splice(in_fd, out_fd, sink, &unsupported);
+                break;
+            case SINK_DIRECT:
+            case SINK_WRITE:
+                written = copy_buffered(in_fd, out_fd, sink,
+                                        cur == SINK_DIRECT);
+                break;
+            default:
+                break;
+        }
+
+        /* a shorter copy over an existing file must not leave its tail */
+        if(written >= 0 && regular) {
+            if(ftruncate(out_fd, sink->offset + written) == -1) written = -1;
+        }
+        if(close(out_fd) == -1) written = -1;
+
+        if(unsupported && strategy == SINK_AUTO) continue;
+        sink->used = cur;
+        return written;
+    }
+    return -1;
+}
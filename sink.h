@@ -0,0 +1,57 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/* How data arriving on a pipe is written to the target.  SINK_AUTO probes
+ * for the cheapest that works, in the order listed. */
+typedef enum {
+    SINK_AUTO,
+    SINK_MMAP, /* map the target and read into it, only device DAX in auto */
+    SINK_SPLICE, /* move pipe pages to the target in the kernel */
+    SINK_DIRECT, /* large aligned O_DIRECT writes */
+    SINK_WRITE, /* plain read and write */
+    SINK_INVALID,
+} sink_strategy;
+
+typedef struct _sink_t sink_t;
+struct _sink_t
+{
+    sink_strategy strategy; /* requested strategy */
+    int64_t offset; /* where in the target to start writing */
+    int64_t size; /* bytes expected, or -1 if unknown, which rules out mmap */
+
+    /* if set, called as data is written, with the count written so far */
+    void (*progress)(sink_t *sink, int64_t written);
+    void *ctx; /* for use by progress */
+
+    /* set by sink_copy() to the strategy used, SINK_INVALID if it failed
+     * before trying one */
+    sink_strategy used;
+};
+
+sink_strategy sink_strategy_from_name(const char *name);
+const char *sink_strategy_name(sink_strategy strategy);
+
+/* Copy everything on in_fd to path, starting at sink->offset.  Returns the
+ * number of bytes written, which is short of sink->size if the input ended
+ * early, or -1 on failure. */
+int64_t sink_copy(int in_fd, const char *path, sink_t *sink);
@@ -0,0 +1,336 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Serve the menu's view of simplestreams JSON to many booting machines at
+ * once, so that each doesn't download and parse the full upstream streams.
+ *
+ * The given streams are parsed once into a catalog of pruned streams, see
+ * stream-prune, one per arch and one covering all of them.  They are served
+ * over HTTP as
+ *
+ *   /<arch>/<stream file name>
+ *   /<stream file name>
+ *
+ * which iso-chooser-menu reads as is.  The inputs are checked at most once a
+ * second, and the catalog is rebuilt only when one of them has changed.  If
+ * a changed input can't be parsed, say while it is being rewritten, the last
+ * good catalog is served until it can.
+ *
+ * With --port=0 a free port is picked.  The port is printed on stdout once
+ * the server is listening.
+ */
+
+#include "common.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "catalog.h"
+#include "json.h"
+
+#define MAX_CONNS 1024
+#define REQUEST_MAX 2048
+
+/* seconds between checks of the inputs, and before an idle client is
+ * dropped */
+#define CHECK_INTERVAL 1.0
+#define IDLE_TIMEOUT 10.0
+
+typedef struct _conn_t
+{
+    int fd;
+    double last_active;
+    char request[REQUEST_MAX];
+    size_t request_len;
+    char *response; /* set once the request is complete */
+    size_t response_len;
+    size_t sent;
+} conn_t;
+
+noreturn void usage(char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--bind=<address>] [--port=<port>] <stream json> "
+            "[<stream json> ...]\n",
+            prog);
+    exit(1);
+}
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int listen_on(const char *address, int port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if(inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+        fprintf(stderr, "invalid address %s\n", address);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1
+            || listen(fd, SOMAXCONN) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int bound_port(int fd)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if(getsockname(fd, (struct sockaddr *)&addr, &len) == -1) return -1;
+    return ntohs(addr.sin_port);
+}
+
+void set_response(conn_t *conn, const char *status, const char *body,
+                  size_t body_len, bool head)
+{
+    char *header = saprintf("HTTP/1.0 %s\r\n"
+                            "Content-Type: %s\r\n"
+                            "Content-Length: %zu\r\n"
+                            "Connection: close\r\n"
+                            "\r\n",
+                            status,
+                            body_len && *body == '{'
+                                ? "application/json" : "text/plain",
+                            body_len);
+    if(!header) return;
+    size_t header_len = strlen(header);
+    if(head) body_len = 0;
+
+    conn->response = malloc(header_len + body_len);
+    if(conn->response) {
+        memcpy(conn->response, header, header_len);
+        memcpy(conn->response + header_len, body, body_len);
+        conn->response_len = header_len + body_len;
+    }
+    free(header);
+}
+
+/* answer a complete request from the catalog */
+void handle_request(catalog_t *catalog, conn_t *conn)
+{
+    char method[8], path[256];
+    if(sscanf(conn->request, "%7s %255s HTTP/", method, path) != 2
+            || path[0] != '/') {
+        set_response(conn, "400 Bad Request", "bad request\n", 12, false);
+        return;
+    }
+
+    bool head = eq(method, "HEAD");
+    if(!head && !eq(method, "GET")) {
+        set_response(conn, "405 Method Not Allowed", "GET only\n", 9, false);
+        return;
+    }
+
+    /* /<arch>/<name> or /<name> */
+    char *arch = path + 1;
+    char *name = strchr(arch, '/');
+    if(name) {
+        *name++ = '\0';
+    } else {
+        name = arch;
+        arch = NULL;
+    }
+
+    const catalog_entry_t *entry = catalog_lookup(catalog, arch, name);
+    if(!entry) {
+        set_response(conn, "404 Not Found", "not found\n", 10, head);
+        return;
+    }
+    set_response(conn, "200 OK", entry->body, entry->len, head);
+}
+
+void conn_close(conn_t *conn)
+{
+    close(conn->fd);
+    free(conn->response);
+    memset(conn, 0, sizeof(*conn));
+    conn->fd = -1;
+}
+
+/* read what has arrived, answering once the request headers are complete */
+void conn_read(catalog_t *catalog, conn_t *conn)
+{
+    ssize_t rv = read(conn->fd, conn->request + conn->request_len,
+                      REQUEST_MAX - 1 - conn->request_len);
+    if(rv == -1 && (errno == EAGAIN || errno == EINTR)) return;
+    if(rv <= 0) {
+        conn_close(conn);
+        return;
+    }
+    conn->request_len += rv;
+    conn->request[conn->request_len] = '\0';
+
+    if(strstr(conn->request, "\r\n\r\n") || strstr(conn->request, "\n\n")) {
+        handle_request(catalog, conn);
+    } else if(conn->request_len == REQUEST_MAX - 1) {
+        set_response(conn, "400 Bad Request", "request too long\n", 17,
+                     false);
+    } else {
+        return;
+    }
+    if(!conn->response) conn_close(conn);
+}
+
+void conn_write(conn_t *conn)
+{
+    ssize_t rv = write(conn->fd, conn->response + conn->sent,
+                       conn->response_len - conn->sent);
+    if(rv == -1 && (errno == EAGAIN || errno == EINTR)) return;
+    if(rv <= 0) {
+        conn_close(conn);
+        return;
+    }
+    conn->sent += rv;
+    if(conn->sent == conn->response_len) conn_close(conn);
+}
+
+void accept_all(int listen_fd, conn_t *conns, int *num_conns)
+{
+    while(true) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd == -1) return;
+
+        int slot = -1;
+        for(int i = 0; i < *num_conns && slot == -1; i++) {
+            if(conns[i].fd == -1) slot = i;
+        }
+        if(slot == -1 && *num_conns < MAX_CONNS) slot = (*num_conns)++;
+        if(slot == -1) {
+            close(fd);
+            continue;
+        }
+        conns[slot].fd = fd;
+        conns[slot].last_active = now();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *address = "0.0.0.0";
+    int port = 8080;
+
+    int cur = 1;
+    for(; cur < argc && strncmp(argv[cur], "--", 2) == 0; cur++) {
+        if(strncmp(argv[cur], "--bind=", 7) == 0) {
+            address = argv[cur] + 7;
+        } else if(strncmp(argv[cur], "--port=", 7) == 0) {
+            char *end = NULL;
+            port = strtol(argv[cur] + 7, &end, 10);
+            if(*end || port < 0 || port > 65535) usage(argv[0]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if(argc - cur < 1) usage(argv[0]);
+
+    catalog_t *catalog = catalog_create(argc - cur, argv + cur);
+    if(!catalog || !catalog_rebuild(catalog)) return 1;
+
+    signal(SIGPIPE, SIG_IGN);
+    int listen_fd = listen_on(address, port);
+    if(listen_fd == -1) {
+        fprintf(stderr, "failed to listen on %s:%d: %m\n", address, port);
+        return 1;
+    }
+    printf("%d\n", bound_port(listen_fd));
+    fflush(stdout);
+
+    conn_t *conns = calloc(sizeof(conn_t), MAX_CONNS);
+    struct pollfd *fds = calloc(sizeof(struct pollfd), MAX_CONNS + 1);
+    if(!conns || !fds) {
+        fprintf(stderr, "alloc failure\n");
+        return 1;
+    }
+    int num_conns = 0;
+    double last_check = now();
+
+    while(true) {
+        fds[0] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+        for(int i = 0; i < num_conns; i++) {
+            fds[i + 1] = (struct pollfd){
+                .fd = conns[i].fd,
+                .events = conns[i].response ? POLLOUT : POLLIN,
+            };
+        }
+
+        if(poll(fds, num_conns + 1, CHECK_INTERVAL * 1000) == -1
+                && errno != EINTR) {
+            fprintf(stderr, "poll: %m\n");
+            return 1;
+        }
+
+        double t = now();
+        if(t - last_check >= CHECK_INTERVAL) {
+            last_check = t;
+            if(catalog_changed(catalog)) {
+                /* what failed keeps being served as it last parsed */
+                bool ok = catalog_rebuild(catalog);
+                fprintf(stderr, "catalog rebuilt%s, %d entries\n",
+                        ok ? "" : " but for failed inputs", catalog->len);
+            }
+        }
+
+        for(int i = 0; i < num_conns; i++) {
+            conn_t *conn = &conns[i];
+            if(conn->fd == -1) continue;
+            short revents = fds[i + 1].revents;
+            if(revents & (POLLERR | POLLNVAL)) {
+                conn_close(conn);
+            } else if(revents & (POLLIN | POLLHUP) && !conn->response) {
+                conn->last_active = t;
+                conn_read(catalog, conn);
+            } else if(revents & POLLOUT) {
+                conn->last_active = t;
+                conn_write(conn);
+            } else if(t - conn->last_active > IDLE_TIMEOUT) {
+                conn_close(conn);
+            }
+        }
+        while(num_conns > 0 && conns[num_conns - 1].fd == -1) num_conns--;
+
+        if(fds[0].revents & POLLIN) accept_all(listen_fd, conns, &num_conns);
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decide from a simplestreams index, streams/v1/index.json, which of the
+ * streams the menu reads need fetching.  Those are the streams of the index
+ * with a content_id the menu knows, see criteria_for_content_id(), and each
+ * is printed as
+ *
+ *   fetch <path>
+ *   keep <path>
+ *
+ * with the path relative to the root of the mirror.  With
+ * --cached=<index.json>, the index of a copy of the streams at hand, a
+ * stream is kept if that index has it at the same path and with the same
+ * updated time, and fetched otherwise.
+ */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+
+#include "json.h"
+
+noreturn void usage(char *prog)
+{
+    fprintf(stderr, "usage: %s [--cached=<index.json>] <index.json>\n", prog);
+    exit(1);
+}
+
+/* the index object of an index file, or NULL if it isn't one */
+json_object *index_of(json_object *root)
+{
+    if(!eq(str(get(root, "format")), "index:1.0")) return NULL;
+    json_object *index = get(root, "index");
+    if(!json_object_is_type(index, json_type_object)) return NULL;
+    return index;
+}
+
+int main(int argc, char **argv)
+{
+    const char *cached_path = NULL;
+
+    int cur = 1;
+    for(; cur < argc && strncmp(argv[cur], "--", 2) == 0; cur++) {
+        if(strncmp(argv[cur], "--cached=", 9) == 0) {
+            cached_path = argv[cur] + 9;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if(argc - cur != 1) usage(argv[0]);
+
+    json_object *root = json_object_from_file(argv[cur]);
+    json_object *index = index_of(root);
+    if(!index) {
+        fprintf(stderr, "%s: not a simplestreams index\n", argv[cur]);
+        json_object_put(root);
+        return 1;
+    }
+
+    /* a cached index that can't be read just means fetching everything */
+    json_object *cached_root = NULL;
+    json_object *cached = NULL;
+    if(cached_path) {
+        cached_root = json_object_from_file(cached_path);
+        cached = index_of(cached_root);
+    }
+
+    json_object_object_foreach(index, content_id, entry) {
+        if(!criteria_for_content_id(content_id)) continue;
+        const char *path = str(get(entry, "path"));
+        const char *updated = str(get(entry, "updated"));
+        if(!path) continue;
+
+        json_object *was = get(cached, content_id);
+        bool keep = updated && eq(str(get(was, "path")), path)
+            && eq(str(get(was, "updated")), updated);
+        printf("%s %s\n", keep ? "keep" : "fetch", path);
+    }
+
+    json_object_put(cached_root);
+    json_object_put(root);
+    return 0;
+}
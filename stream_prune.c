@@ -0,0 +1,103 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Rewrite simplestreams JSON into the much smaller files that are all the
+ * menu needs, for a mirror to serve in place of the upstream streams.  Each
+ * input is written to the output directory under the same file name, keeping
+ * only the products iso-chooser-menu would offer, with the iso item of their
+ * newest version.  The result is still a valid stream, read by the menu as
+ * is.
+ *
+ * With --arch=<arch>, only products for that arch are kept.
+ */
+
+#include "common.h"
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "json.h"
+
+noreturn void usage(char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--arch=<arch>] <output dir> <input json> "
+            "[<input json> ...]\n",
+            prog);
+    exit(1);
+}
+
+long file_size(const char *path)
+{
+    struct stat st;
+    if(stat(path, &st) == -1) return -1;
+    return st.st_size;
+}
+
+int main(int argc, char **argv)
+{
+    const char *arch = NULL;
+
+    int cur = 1;
+    for(; cur < argc && strncmp(argv[cur], "--", 2) == 0; cur++) {
+        if(strncmp(argv[cur], "--arch=", 7) == 0) {
+            arch = argv[cur] + 7;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if(argc - cur < 2) usage(argv[0]);
+    const char *outdir = argv[cur++];
+
+    int rc = 0;
+    for(; cur < argc; cur++) {
+        const char *infile = argv[cur];
+        json_object *root = stream_from_file(infile);
+        json_object *pruned = root ? prune_stream(root, arch) : NULL;
+        if(!pruned) {
+            fprintf(stderr, "%s: not a stream the menu reads\n", infile);
+            json_object_put(root);
+            rc = 1;
+            continue;
+        }
+
+        char *copy = strdup(infile);
+        char *outfile = copy ? saprintf("%s/%s", outdir, basename(copy)) : NULL;
+        int flags = JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE;
+        if(!outfile || json_object_to_file_ext(outfile, pruned, flags) != 0) {
+            fprintf(stderr, "%s: failed to write %s\n", infile,
+                    outfile ? outfile : outdir);
+            rc = 1;
+        } else {
+            printf("%s %ld -> %ld bytes\n", outfile, file_size(infile),
+                   file_size(outfile));
+        }
+
+        free(outfile);
+        free(copy);
+        json_object_put(pruned);
+        json_object_put(root);
+    }
+    return rc;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "terminfo.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+/* entries are looked up as <dir>/<first letter>/<name> */
+static char *entry_path(const char *dir, const char *name)
+{
+    return saprintf("%s/%c/%s", dir, name[0], name);
+}
+
+static char *entry_subdir(const char *dir, const char *name)
+{
+    return saprintf("%s/%c", dir, name[0]);
+}
+
+char *terminfo_install(const char *name, const uint8_t *data, size_t len)
+{
+    if(!name || !*name || strchr(name, '/') || !data) return NULL;
+
+    const char *tmp = getenv("TMPDIR");
+    char *dir = saprintf("%s/terminfo.XXXXXX", tmp ? tmp : "/tmp");
+    if(!dir) return NULL;
+    if(!mkdtemp(dir)) {
+        syslog(LOG_ERR, "failed to create %s: %m", dir);
+        free(dir);
+        return NULL;
+    }
+
+    char *subdir = entry_subdir(dir, name);
+    char *path = entry_path(dir, name);
+    int fd = -1;
+    bool ok = subdir && path && mkdir(subdir, 0700) == 0
+        && (fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                      0600)) != -1
+        && write(fd, data, len) == (ssize_t)len;
+    if(fd != -1 && close(fd) == -1) ok = false;
+    free(subdir);
+    free(path);
+
+    if(!ok) {
+        syslog(LOG_ERR, "failed to write terminfo for %s: %m", name);
+        terminfo_remove(dir, name);
+        return NULL;
+    }
+    setenv("TERMINFO", dir, 1);
+    return dir;
+}
+
+void terminfo_remove(char *dir, const char *name)
+{
+    if(!dir) return;
+
+    /* whatever terminfo_install() got as far as writing */
+    char *path = entry_path(dir, name);
+    char *subdir = entry_subdir(dir, name);
+    if(path) unlink(path);
+    if(subdir) rmdir(subdir);
+    rmdir(dir);
+    free(path);
+    free(subdir);
+    free(dir);
+}
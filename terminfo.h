@@ -0,0 +1,31 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Make a compiled terminfo entry for the terminal name available to ncurses
+ * without it being installed, by writing it to a private directory that
+ * TERMINFO is pointed at.  Returns that directory, to be removed with
+ * terminfo_remove() once ncurses has read the entry, or NULL on failure,
+ * which leaves TERMINFO alone. */
+char *terminfo_install(const char *name, const uint8_t *data, size_t len);
+void terminfo_remove(char *dir, const char *name);
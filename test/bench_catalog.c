@@ -0,0 +1,167 @@
+/* Load test stream-catalog: start it on a free port, then have many clients
+ * fetch a stream at once, one connection per request, as booting machines
+ * would.  Reports requests per second and the latency distribution.
+ *
+ * usage: bench_catalog <stream-catalog> <stream json> [<stream json> ...] */
+
+#include "common.h"
+
+#include <arpa/inet.h>
+#include <libgen.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define CLIENTS 64
+#define REQUESTS_PER_CLIENT 500
+
+typedef struct _client_t
+{
+    pthread_t thread;
+    int port;
+    const char *request;
+    double latencies[REQUESTS_PER_CLIENT];
+    int errors;
+} client_t;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* fetch once, true if the whole of a 200 response arrived */
+static bool fetch(int port, const char *request)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) return false;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    bool ok = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0
+        && write(fd, request, strlen(request)) == (ssize_t)strlen(request);
+
+    char buf[16384];
+    size_t len = 0;
+    ssize_t rv;
+    while(ok && (rv = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0) {
+        len += rv;
+        if(len == sizeof(buf) - 1) break;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return ok && strncmp(buf, "HTTP/1.0 200 ", 13) == 0
+        && strstr(buf, "\r\n\r\n{");
+}
+
+static void *client(void *arg)
+{
+    client_t *c = arg;
+    for(int i = 0; i < REQUESTS_PER_CLIENT; i++) {
+        double start = now();
+        if(!fetch(c->port, c->request)) c->errors++;
+        c->latencies[i] = now() - start;
+    }
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* start the server, returning its pid and the port it listens on */
+static pid_t start_server(char **argv, int *port)
+{
+    int pipefd[2];
+    if(pipe(pipefd) == -1) return -1;
+    pid_t pid = fork();
+    if(pid == 0) {
+        dup2(pipefd[1], STDOUT_FILENO);
+        close(pipefd[0]);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    close(pipefd[1]);
+
+    FILE *f = fdopen(pipefd[0], "r");
+    if(pid == -1 || !f || fscanf(f, "%d", port) != 1) {
+        if(pid > 0) kill(pid, SIGTERM);
+        return -1;
+    }
+    fclose(f);
+    return pid;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3) {
+        fprintf(stderr,
+                "usage: %s <stream-catalog> <stream json> [...]\n", argv[0]);
+        return 1;
+    }
+
+    char **server_argv = calloc(sizeof(char *), argc + 2);
+    server_argv[0] = argv[1];
+    server_argv[1] = "--bind=127.0.0.1";
+    server_argv[2] = "--port=0";
+    for(int i = 2; i < argc; i++) server_argv[i + 1] = argv[i];
+
+    int port = 0;
+    pid_t pid = start_server(server_argv, &port);
+    if(pid == -1) {
+        fprintf(stderr, "failed to start %s\n", argv[1]);
+        return 1;
+    }
+
+    char *request = saprintf("GET /%s/%s HTTP/1.0\r\n\r\n", ARCH,
+                             basename(argv[2]));
+    client_t *clients = calloc(sizeof(client_t), CLIENTS);
+    double start = now();
+    for(int i = 0; i < CLIENTS; i++) {
+        clients[i].port = port;
+        clients[i].request = request;
+        pthread_create(&clients[i].thread, NULL, client, &clients[i]);
+    }
+    int errors = 0;
+    for(int i = 0; i < CLIENTS; i++) {
+        pthread_join(clients[i].thread, NULL);
+        errors += clients[i].errors;
+    }
+    double elapsed = now() - start;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    int total = CLIENTS * REQUESTS_PER_CLIENT;
+    double *all = calloc(sizeof(double), total);
+    for(int i = 0; i < CLIENTS; i++) {
+        memcpy(all + i * REQUESTS_PER_CLIENT, clients[i].latencies,
+               sizeof(clients[i].latencies));
+    }
+    qsort(all, total, sizeof(double), cmp_double);
+
+    printf("catalog clients=%d requests=%d errors=%d seconds=%.2f "
+           "req_per_s=%.0f p50_ms=%.3f p99_ms=%.3f max_ms=%.3f\n",
+           CLIENTS, total, errors, elapsed, total / elapsed,
+           all[total / 2] * 1000, all[total * 99 / 100] * 1000,
+           all[total - 1] * 1000);
+
+    free(all);
+    free(clients);
+    free(request);
+    free(server_argv);
+    return errors ? 1 : 0;
+}
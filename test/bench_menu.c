@@ -0,0 +1,290 @@
+/* Measure what drawing the menu costs: run iso-chooser-menu under a pty of
+ * a given size and TERM, type a script of keys, and report for the startup
+ * and each key the bytes written to the terminal, the read and write
+ * syscalls the menu made (from /proc/<pid>/io) and the latency until its
+ * output settled.  With --baud=, the terminal side drains output no faster
+ * than a serial console would, as BMC consoles do.
+ *
+ * usage: bench_menu [--rows=<n>] [--cols=<n>] [--term=<name>] [--baud=<n>]
+ *                   [--keys=<key,...>] <iso-chooser-menu> <stream json> ...
+ *
+ * Keys are "down", "up" and "enter", sent as the terminfo sequences of
+ * --term, the default script moving down and back up the menu before
+ * choosing. */
+
+#include "common.h"
+
+#include <errno.h>
+#include <ncurses.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <term.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+
+#define MAX_KEYS 64
+/* output is taken to have settled after this long without any */
+#define SETTLE_MS 100
+/* give up on a key whose output has not settled after this long */
+#define TIMEOUT_MS 10000
+
+typedef struct _io_t
+{
+    long long syscr;
+    long long syscw;
+} io_t;
+
+typedef struct _sample_t
+{
+    const char *name;
+    long long bytes;
+    io_t io;
+    double first_ms; /* until the first byte of output */
+    double done_ms;  /* until the last byte before output settled */
+} sample_t;
+
+typedef struct _bench_t
+{
+    int master;
+    pid_t pid;
+    int baud;
+    io_t io; /* as of the end of the previous sample */
+} bench_t;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleep_until(double when)
+{
+    double delay = when - now();
+    if(delay <= 0) return;
+    struct timespec ts = {
+        .tv_sec = (time_t)delay,
+        .tv_nsec = (long)((delay - (time_t)delay) * 1e9),
+    };
+    while(nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+/* false once the menu has exited and its counters are gone */
+static bool read_io(pid_t pid, io_t *io)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+    FILE *f = fopen(path, "r");
+    if(!f) return false;
+
+    char key[32];
+    long long val;
+    int found = 0;
+    while(fscanf(f, "%31[^:]: %lld\n", key, &val) == 2) {
+        if(strcmp(key, "syscr") == 0) io->syscr = val, found++;
+        if(strcmp(key, "syscw") == 0) io->syscw = val, found++;
+    }
+    fclose(f);
+    return found == 2;
+}
+
+/* Drain the menu's output until it settles, starting from sent, throttled
+ * to baud if set: ten bits a byte, in slices of a hundredth of a second.
+ * At startup the menu is loading streams, so the first output may take a
+ * while. */
+static void drain(bench_t *bench, double sent, bool startup,
+                  sample_t *sample)
+{
+    char buf[65536];
+    size_t slice = sizeof(buf);
+    if(bench->baud) {
+        slice = bench->baud / 10 / 100;
+        if(slice < 1) slice = 1;
+    }
+
+    double last = sent;
+    struct pollfd pfd = {.fd = bench->master, .events = POLLIN};
+    for(;;) {
+        int timeout = SETTLE_MS - (int)((now() - last) * 1000);
+        if(startup && !sample->bytes) {
+            timeout = TIMEOUT_MS - (int)((now() - sent) * 1000);
+        }
+        if(now() - sent > TIMEOUT_MS / 1000.0 || timeout <= 0) break;
+        if(poll(&pfd, 1, timeout) <= 0) continue;
+
+        double start = now();
+        ssize_t got = read(bench->master, buf, slice);
+        if(got <= 0) break; /* EIO once the menu has exited */
+        last = now();
+        if(!sample->bytes) sample->first_ms = (last - sent) * 1000;
+        sample->bytes += got;
+        sample->done_ms = (last - sent) * 1000;
+        if(bench->baud) {
+            sleep_until(start + got * 10.0 / bench->baud);
+            last = now();
+        }
+    }
+
+    io_t io = bench->io;
+    if(read_io(bench->pid, &io)) {
+        sample->io.syscr = io.syscr - bench->io.syscr;
+        sample->io.syscw = io.syscw - bench->io.syscw;
+        bench->io = io;
+    }
+}
+
+static const char *key_sequence(const char *name)
+{
+    const char *cap = NULL;
+    if(strcmp(name, "down") == 0) cap = "kcud1";
+    else if(strcmp(name, "up") == 0) cap = "kcuu1";
+    else if(strcmp(name, "enter") == 0) return "\r";
+    if(!cap) return NULL;
+
+    char *seq = tigetstr(cap);
+    if(!seq || seq == (char *)-1) return NULL;
+    return seq;
+}
+
+static void print_sample(const sample_t *sample)
+{
+    printf("key name=%s bytes=%lld syscr=%lld syscw=%lld first_ms=%.3f "
+           "done_ms=%.3f\n",
+           sample->name, sample->bytes, sample->io.syscr, sample->io.syscw,
+           sample->first_ms, sample->done_ms);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static noreturn void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--rows=<n>] [--cols=<n>] [--term=<name>] "
+            "[--baud=<n>] [--keys=<key,...>] <iso-chooser-menu> "
+            "<stream json> [...]\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    struct winsize ws = {.ws_row = 25, .ws_col = 80};
+    const char *term = "linux";
+    char *keys = strdup("down,down,down,up,up,up,down,enter");
+    int baud = 0;
+
+    int cur = 1;
+    for(; cur < argc && strncmp(argv[cur], "--", 2) == 0; cur++) {
+        char *arg = argv[cur];
+        if(strncmp(arg, "--rows=", 7) == 0) ws.ws_row = atoi(arg + 7);
+        else if(strncmp(arg, "--cols=", 7) == 0) ws.ws_col = atoi(arg + 7);
+        else if(strncmp(arg, "--term=", 7) == 0) term = arg + 7;
+        else if(strncmp(arg, "--baud=", 7) == 0) baud = atoi(arg + 7);
+        else if(strncmp(arg, "--keys=", 7) == 0) {
+            free(keys);
+            keys = strdup(arg + 7);
+        } else usage(argv[0]);
+    }
+    if(argc - cur < 2 || !ws.ws_row || !ws.ws_col || baud < 0) {
+        usage(argv[0]);
+    }
+
+    /* key sequences come from the terminfo the menu will use */
+    int err = 0;
+    if(setupterm((char *)term, STDERR_FILENO, &err) != OK) {
+        fprintf(stderr, "no terminfo for %s\n", term);
+        return 1;
+    }
+
+    sample_t samples[MAX_KEYS + 1] = {{.name = "startup"}};
+    const char *sequences[MAX_KEYS];
+    int num_keys = 0;
+    for(char *save, *name = strtok_r(keys, ",", &save); name;
+            name = strtok_r(NULL, ",", &save)) {
+        if(num_keys == MAX_KEYS
+                || !(sequences[num_keys] = key_sequence(name))) {
+            fprintf(stderr, "unknown or too many keys at %s\n", name);
+            return 1;
+        }
+        samples[++num_keys].name = name;
+    }
+
+    char output[] = "/tmp/bench_menu.XXXXXX";
+    int fd = mkstemp(output);
+    if(fd == -1) return 1;
+    close(fd);
+
+    char **menu_argv = calloc(sizeof(char *), argc - cur + 2);
+    menu_argv[0] = argv[cur];
+    menu_argv[1] = output;
+    for(int i = cur + 1; i < argc; i++) menu_argv[i - cur + 1] = argv[i];
+
+    bench_t bench = {.baud = baud};
+    double start = now();
+    bench.pid = forkpty(&bench.master, NULL, NULL, &ws);
+    if(bench.pid == 0) {
+        setenv("TERM", term, 1);
+        execv(menu_argv[0], menu_argv);
+        _exit(127);
+    }
+    if(bench.pid == -1) {
+        perror("forkpty");
+        return 1;
+    }
+
+    drain(&bench, start, true, &samples[0]);
+    print_sample(&samples[0]);
+    for(int i = 1; i <= num_keys; i++) {
+        size_t len = strlen(sequences[i - 1]);
+        double sent = now();
+        if(write(bench.master, sequences[i - 1], len) != (ssize_t)len) break;
+        drain(&bench, sent, false, &samples[i]);
+        print_sample(&samples[i]);
+    }
+
+    int status = 0;
+    kill(bench.pid, SIGTERM);
+    waitpid(bench.pid, &status, 0);
+
+    /* the menu only exits on its own once a choice is made */
+    FILE *f = fopen(output, "r");
+    char line[16];
+    bool chosen = f && fgets(line, sizeof(line), f)
+        && strncmp(line, "MEDIA_", 6) == 0;
+    if(f) fclose(f);
+    unlink(output);
+
+    double latencies[MAX_KEYS];
+    long long bytes = 0, syscr = 0, syscw = 0;
+    for(int i = 1; i <= num_keys; i++) {
+        latencies[i - 1] = samples[i].done_ms;
+        bytes += samples[i].bytes;
+        syscr += samples[i].io.syscr;
+        syscw += samples[i].io.syscw;
+    }
+    qsort(latencies, num_keys, sizeof(double), cmp_double);
+
+    printf("menu term=%s rows=%d cols=%d baud=%d chosen=%d "
+           "startup_bytes=%lld startup_ms=%.3f keys=%d key_bytes=%lld "
+           "key_syscr=%lld key_syscw=%lld p50_ms=%.3f max_ms=%.3f\n",
+           term, ws.ws_row, ws.ws_col, baud, chosen, samples[0].bytes,
+           samples[0].done_ms, num_keys, bytes, syscr, syscw,
+           num_keys ? latencies[num_keys / 2] : 0,
+           num_keys ? latencies[num_keys - 1] : 0);
+
+    free(menu_argv);
+    free(keys);
+    return chosen ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/* Report how long json-c and each scan kernel supported here take to parse
+ * a synthetic stream the size of the internal daily ones.
+ *
+ * usage: bench_scan [<products>] */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <json-c/json.h>
+
+#include "scan.h"
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* products of 30 versions of 6 items, with the keys streams have but the
+ * menu does not read */
+static long write_stream(FILE *out, int products)
+{
+    const char *items[] = {"iso", "iso.zsync", "list", "manifest",
+                           "squashfs", "vmlinuz"};
+    fprintf(out, "{\"content_id\": \"com.ubuntu.cdimage.daily:ubuntu\",\n"
+                 " \"datatype\": \"image-downloads\", \"format\": "
+                 "\"products:1.0\", \"updated\": \"Mon, 01 May 2023\",\n"
+                 " \"products\": {\n");
+    for(int p = 0; p < products; p++) {
+        fprintf(out, "  \"com.ubuntu.cdimage.daily:ubuntu:%d:amd64\": {\n"
+                     "   \"aliases\": \"%d,%d.04\", \"arch\": \"amd64\","
+                     " \"os\": \"ubuntu\", \"image_type\": \"daily-live\",\n"
+                     "   \"release\": \"r%d\", \"release_codename\": "
+                     "\"Codename %d\", \"release_title\": \"%d.04\",\n"
+                     "   \"support_eol\": \"2030-04-01\", \"version\": "
+                     "\"%d.04\",\n   \"versions\": {\n",
+                p, p, p, p, p, p, p);
+        for(int v = 0; v < 30; v++) {
+            fprintf(out, "    \"202301%02d\": {\"label\": \"daily\", "
+                         "\"pubname\": \"ubuntu-%d-daily\", \"items\": {\n",
+                    v, p);
+            for(int i = 0; i < 6; i++) {
+                fprintf(out, "     \"%s\": {\"ftype\": \"%s\", \"md5\": "
+                             "\"%032x\", \"path\": \"ubuntu/daily-live/"
+                             "202301%02d/r%d-desktop-amd64.%s\", "
+                             "\"sha256\": \"%064x\", \"size\": %d}%s\n",
+                        items[i], items[i], p * 30 + v, v, p, items[i],
+                        p * 30 + v, 4000000 + i, i < 5 ? "," : "");
+            }
+            fprintf(out, "    }}%s\n", v < 29 ? "," : "");
+        }
+        fprintf(out, "   }}%s\n", p < products - 1 ? "," : "");
+    }
+    fprintf(out, " }\n}\n");
+    return ftell(out);
+}
+
+/* in a child, so each parser starts from the same heap */
+static void report(const char *name, long len, json_object *(*parse)(
+                           const char *), const char *filename)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid < 0) return;
+    if(pid > 0) {
+        waitpid(pid, NULL, 0);
+        return;
+    }
+
+    /* the fastest of a few runs */
+    double best = 0;
+    for(int run = 0; run < 5; run++) {
+        double start = now();
+        json_object *root = parse(filename);
+        double elapsed = now() - start;
+        if(!root) {
+            printf("%-7s %8s\n", name, "failed");
+            _exit(1);
+        }
+        json_object_put(root);
+        if(run == 0 || elapsed < best) best = elapsed;
+    }
+    printf("%-7s %8.2f %8.1f\n", name, best * 1e3, len / best / 1e6);
+    fflush(stdout);
+    _exit(0);
+}
+
+int main(int argc, char **argv)
+{
+    int products = argc > 1 ? atoi(argv[1]) : 400;
+    char filename[] = "/tmp/bench_scan.XXXXXX";
+    int fd = mkstemp(filename);
+    FILE *out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if(!out) return 1;
+    long len = write_stream(out, products);
+    fclose(out);
+
+    printf("%ld bytes\n%-7s %8s %8s\n", len, "parser", "ms", "MB/s");
+    report("json-c", len, json_object_from_file, filename);
+    const char *names[] = {"avx2", "sse2", "neon"};
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if(!scan_use_kernel(names[i])) {
+            printf("%-7s %8s\n", names[i], "n/a");
+            continue;
+        }
+        report(names[i], len, scan_stream_file, filename);
+    }
+
+    unlink(filename);
+    return 0;
+}
@@ -0,0 +1,62 @@
+/* Report the throughput of each SHA-256 kernel supported here, in cycles per
+ * byte where a cycle counter is available.
+ *
+ * usage: bench_sha256 [<MiB to hash>] */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define cycles() __rdtsc()
+#endif
+
+#include "sha256.h"
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    size_t len = (size_t)(argc > 1 ? atoi(argv[1]) : 256) * 1024 * 1024;
+    uint8_t *data = malloc(len);
+    if(!data) return 1;
+    memset(data, 0x5a, len);
+
+    const char *names[] = {"shani", "armv8", "portable"};
+    printf("%-9s %8s %10s\n", "kernel", "GB/s", "cycles/B");
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if(!sha256_use_kernel(names[i])) {
+            printf("%-9s %8s\n", names[i], "n/a");
+            continue;
+        }
+
+        sha256_t ctx;
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        double start = now();
+#ifdef cycles
+        unsigned long long start_cycles = cycles();
+#endif
+        sha256_init(&ctx);
+        sha256_update(&ctx, data, len);
+        sha256_final(&ctx, digest);
+        double elapsed = now() - start;
+
+        printf("%-9s %8.2f", names[i], len / elapsed / 1e9);
+#ifdef cycles
+        printf(" %10.2f", (double)(cycles() - start_cycles) / len);
+#endif
+        printf("\n");
+    }
+
+    free(data);
+    return 0;
+}
@@ -0,0 +1,118 @@
+/* Compare the sink strategies writing to a plain file and to a tmpfs file,
+ * standing in for the reserved memory device.  Reports throughput and the
+ * CPU time spent on the writing side.
+ *
+ * usage: bench_sink [<MiB to write>] */
+
+#include "common.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "sink.h"
+
+#define BUF_SIZE (4 * 1024 * 1024)
+
+static double seconds(struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static double cpu_seconds(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return seconds(&usage.ru_utime) + seconds(&usage.ru_stime);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* write size bytes into a pipe from a child, as wget would */
+static pid_t feeder(int64_t size, int *ret_fd)
+{
+    int pipefd[2];
+    if(pipe(pipefd) == -1) return -1;
+    fcntl(pipefd[1], F_SETPIPE_SZ, 1024 * 1024);
+
+    pid_t pid = fork();
+    if(pid == 0) {
+        close(pipefd[0]);
+        char *buf = malloc(BUF_SIZE);
+        if(!buf) _exit(1);
+        memset(buf, 0xa5, BUF_SIZE);
+        while(size > 0) {
+            ssize_t rv = write(pipefd[1], buf,
+                               size < BUF_SIZE ? size : BUF_SIZE);
+            if(rv <= 0) _exit(1);
+            size -= rv;
+        }
+        _exit(0);
+    }
+    close(pipefd[1]);
+    *ret_fd = pipefd[0];
+    return pid;
+}
+
+static void run(const char *label, const char *path, int64_t size,
+                sink_strategy strategy)
+{
+    int fd = -1;
+    pid_t pid = feeder(size, &fd);
+    if(pid == -1) {
+        perror("feeder");
+        exit(1);
+    }
+
+    double cpu = cpu_seconds();
+    double start = now();
+    sink_t sink = {.strategy = strategy, .size = size};
+    int64_t written = sink_copy(fd, path, &sink);
+    double elapsed = now() - start;
+    cpu = cpu_seconds() - cpu;
+
+    close(fd);
+    waitpid(pid, NULL, 0);
+    unlink(path);
+
+    if(written != size) {
+        printf("%-6s %-7s failed\n", label, sink_strategy_name(strategy));
+        return;
+    }
+    printf("%-6s %-7s %-7s %8.2f %8.3f\n",
+           label, sink_strategy_name(strategy), sink_strategy_name(sink.used),
+           size / elapsed / 1e9, cpu);
+}
+
+int main(int argc, char **argv)
+{
+    int64_t size = (int64_t)(argc > 1 ? atoi(argv[1]) : 1024) * 1024 * 1024;
+
+    struct {
+        const char *label;
+        const char *path;
+    } targets[] = {
+        {"file", "bench_sink.out"},
+        {"tmpfs", "/dev/shm/bench_sink.out"},
+    };
+
+    printf("%-6s %-7s %-7s %8s %8s\n",
+           "target", "asked", "used", "GB/s", "cpu s");
+    for(size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        for(int s = 0; s < SINK_INVALID; s++) {
+            run(targets[t].label, targets[t].path, size, s);
+        }
+    }
+    return 0;
+}
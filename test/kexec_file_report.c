@@ -0,0 +1,54 @@
+/* Stands in for kexec_file.c in iso-kexec-e2e, which scripts/e2e runs in
+ * place of iso-kexec: what would have been loaded is printed instead, as
+ *   kernel <size> <sha256>
+ *   initrd <size> <sha256>
+ *   command-line <command line>
+ */
+
+#include "common.h"
+#include "kexec_file.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sha256.h"
+
+#define CHUNK_SIZE (1024 * 1024)
+
+static bool print_loaded(const char *name, int memfd)
+{
+    uint8_t *buf = malloc(CHUNK_SIZE);
+    if(!buf) return false;
+
+    sha256_t ctx;
+    sha256_init(&ctx);
+    uint64_t size = 0;
+    ssize_t rv;
+    while((rv = pread(memfd, buf, CHUNK_SIZE, size)) > 0) {
+        sha256_update(&ctx, buf, rv);
+        size += rv;
+    }
+    free(buf);
+    if(rv == -1) {
+        perror(name);
+        return false;
+    }
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    char hex[2 * SHA256_DIGEST_SIZE + 1];
+    sha256_final(&ctx, digest);
+    sha256_hex(digest, hex);
+    printf("%s %" PRIu64 " %s\n", name, size, hex);
+    return true;
+}
+
+bool kexec_file_load_fds(int kernel, int initrd, const char *cmdline)
+{
+    if(!print_loaded("kernel", kernel) || !print_loaded("initrd", initrd)) {
+        return false;
+    }
+    printf("command-line %s\n", cmdline);
+    return true;
+}
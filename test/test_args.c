@@ -47,6 +47,158 @@ static void args_infile_missing(void **state)
     assert_null(args);
 }
 
+static void args_timing(void **state)
+{
+    char *argv[] = {
+        "program",
+        "--timing=/tmp/timing",
+        "outfile",
+        "test/data/empty-obj.json",
+        NULL
+    };
+    args_t *args = args_create(4, argv);
+    assert_non_null(args);
+    assert_string_equal("/tmp/timing", args->timing_path);
+    assert_string_equal(argv[2], args->outfile);
+    assert_int_equal(1, args->num_infiles);
+    assert_string_equal(argv[3], args->infiles[0]);
+}
+
+static void args_no_timing(void **state)
+{
+    char *argv[] = {"program", "outfile", "test/data/empty-obj.json", NULL};
+    args_t *args = args_create(3, argv);
+    assert_non_null(args);
+    assert_null(args->timing_path);
+}
+
+static void args_console_font(void **state)
+{
+    char *argv[] = {
+        "program",
+        "--console-font",
+        "outfile",
+        "test/data/empty-obj.json",
+        NULL
+    };
+    args_t *args = args_create(4, argv);
+    assert_non_null(args);
+    assert_true(args->console_font);
+    assert_string_equal(argv[2], args->outfile);
+
+    char *without[] = {"program", "outfile", "test/data/empty-obj.json", NULL};
+    args = args_create(3, without);
+    assert_non_null(args);
+    assert_false(args->console_font);
+}
+
+static void args_refresh(void **state)
+{
+    /* the marker is only written later, so needn't exist */
+    char *argv[] = {
+        "program",
+        "--refresh=/nonexistent/ready",
+        "outfile",
+        "test/data/empty-obj.json",
+        NULL
+    };
+    args_t *args = args_create(4, argv);
+    assert_non_null(args);
+    assert_string_equal("/nonexistent/ready", args->refresh_path);
+    assert_int_equal(1, args->num_infiles);
+}
+
+static void args_max_size(void **state)
+{
+    char *argv[] = {
+        "program",
+        "--max-size=1642631168",
+        "outfile",
+        "test/data/empty-obj.json",
+        NULL
+    };
+    args_t *args = args_create(4, argv);
+    assert_non_null(args);
+    assert_int_equal(1642631168, args->max_size);
+
+    char *without[] = {"program", "outfile", "test/data/empty-obj.json", NULL};
+    args = args_create(3, without);
+    assert_non_null(args);
+    assert_int_equal(0, args->max_size);
+
+    char *bad[] = {"--max-size=", "--max-size=0", "--max-size=-1",
+                   "--max-size=1G"};
+    for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        argv[1] = bad[i];
+        assert_null(args_create(4, argv));
+    }
+}
+
+static void args_mirrors(void **state)
+{
+    char *argv[] = {
+        "program",
+        "--mirrors=test/data/mirrors",
+        "outfile",
+        "test/data/empty-obj.json",
+        NULL
+    };
+    args_t *args = args_create(4, argv);
+    assert_non_null(args);
+    assert_string_equal("test/data/mirrors", args->mirrors_path);
+    assert_string_equal(argv[2], args->outfile);
+}
+
+static void args_mirrors_missing(void **state)
+{
+    char *argv[] = {
+        "program",
+        "--mirrors=/not/exist",
+        "outfile",
+        "test/data/empty-obj.json",
+        NULL
+    };
+    args_t *args = args_create(4, argv);
+    assert_null(args);
+}
+
+static void args_policy(void **state)
+{
+    char *argv[] = {
+        "program",
+        "--policy=test/data/mirrors",
+        "--mirrors=test/data/mirrors",
+        "outfile",
+        "test/data/empty-obj.json",
+        NULL
+    };
+    args_t *args = args_create(5, argv);
+    assert_non_null(args);
+    assert_string_equal("test/data/mirrors", args->policy_path);
+    assert_string_equal("test/data/mirrors", args->mirrors_path);
+    assert_string_equal(argv[3], args->outfile);
+}
+
+static void args_unknown_option(void **state)
+{
+    char *argv[] = {
+        "program",
+        "--bogus=1",
+        "outfile",
+        "test/data/empty-obj.json",
+        NULL
+    };
+    args_t *args = args_create(4, argv);
+    assert_null(args);
+}
+
+static void args_only_options(void **state)
+{
+    char *argv[] = {"program", "--timing=/tmp/timing", NULL};
+    args_t *args = args_create(2, argv);
+    assert_null(args);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -54,6 +206,16 @@ int main(void)
         cmocka_unit_test(args_one_infile),
         cmocka_unit_test(args_two_infiles),
         cmocka_unit_test(args_infile_missing),
+        cmocka_unit_test(args_timing),
+        cmocka_unit_test(args_no_timing),
+        cmocka_unit_test(args_console_font),
+        cmocka_unit_test(args_refresh),
+        cmocka_unit_test(args_max_size),
+        cmocka_unit_test(args_mirrors),
+        cmocka_unit_test(args_mirrors_missing),
+        cmocka_unit_test(args_policy),
+        cmocka_unit_test(args_unknown_option),
+        cmocka_unit_test(args_only_options),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
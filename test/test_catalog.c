@@ -0,0 +1,190 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <json-c/json.h>
+
+#include "catalog.h"
+#include "json.h"
+
+#define SERVER "test/data/com.ubuntu.releases:ubuntu-server.json"
+#define DESKTOP "test/data/com.ubuntu.releases:ubuntu.json"
+
+static char dir[] = "/tmp/test_catalog.XXXXXX";
+static char *path;
+
+static int setup(void **state)
+{
+    if(!mkdtemp(dir)) return -1;
+    path = saprintf("%s/stream.json", dir);
+    return path ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+    unlink(path);
+    free(path);
+    return rmdir(dir);
+}
+
+static void copy_file(const char *src, const char *dest)
+{
+    json_object *root = json_object_from_file(src);
+    assert_non_null(root);
+    char *tmp = saprintf("%s.tmp", dest);
+    assert_int_equal(0, json_object_to_file_ext(tmp, root,
+                                                JSON_C_TO_STRING_PLAIN));
+    /* replaced as a whole, the way a mirror sync does */
+    assert_int_equal(0, rename(tmp, dest));
+    free(tmp);
+    json_object_put(root);
+}
+
+static void catalog_build(void **state)
+{
+    char *paths[] = {SERVER, DESKTOP};
+    catalog_t *catalog = catalog_create(2, paths);
+    assert_non_null(catalog);
+    assert_true(catalog_changed(catalog));
+    assert_true(catalog_rebuild(catalog));
+    assert_false(catalog_changed(catalog));
+
+    const char *name = "com.ubuntu.releases:ubuntu-server.json";
+    const catalog_entry_t *all = catalog_lookup(catalog, NULL, name);
+    const catalog_entry_t *amd64 = catalog_lookup(catalog, "amd64", name);
+    assert_non_null(all);
+    assert_non_null(amd64);
+    assert_null(catalog_lookup(catalog, "m68k", name));
+    assert_null(catalog_lookup(catalog, NULL, "missing.json"));
+    assert_non_null(catalog_lookup(catalog, "amd64",
+                                   "com.ubuntu.releases:ubuntu.json"));
+
+    /* what the menu reads from an entry matches the original stream */
+    json_object *root = json_tokener_parse(amd64->body);
+    assert_non_null(root);
+    assert_int_equal(strlen(amd64->body), amd64->len);
+    choices_t *expected = choices_create(10);
+    choices_t *actual = choices_create(10);
+    choices_extend_from_json(expected, SERVER, "amd64");
+    assert_true(choices_extend_from_root(actual, root, "amd64"));
+    assert_int_equal(expected->len, actual->len);
+    for(int i = 0; i < expected->len; i++) {
+        assert_string_equal(expected->values[i]->url,
+                            actual->values[i]->url);
+    }
+    json_object_put(root);
+    choices_free(expected);
+    choices_free(actual);
+
+    catalog_free(catalog);
+}
+
+static void catalog_rebuild_on_change(void **state)
+{
+    copy_file(SERVER, path);
+    catalog_t *catalog = catalog_create(1, &path);
+    assert_true(catalog_rebuild(catalog));
+    assert_false(catalog_changed(catalog));
+    assert_non_null(catalog_lookup(catalog, "amd64", "stream.json"));
+
+    copy_file(DESKTOP, path);
+    assert_true(catalog_changed(catalog));
+    assert_true(catalog_rebuild(catalog));
+    assert_false(catalog_changed(catalog));
+    const catalog_entry_t *entry = catalog_lookup(catalog, "amd64",
+                                                  "stream.json");
+    assert_non_null(strstr(entry->body, "\"com.ubuntu.releases:ubuntu\""));
+
+    catalog_free(catalog);
+}
+
+static void catalog_keeps_last_good(void **state)
+{
+    copy_file(SERVER, path);
+    catalog_t *catalog = catalog_create(1, &path);
+    assert_true(catalog_rebuild(catalog));
+    int len = catalog->len;
+
+    FILE *f = fopen(path, "w");
+    assert_non_null(f);
+    fputs("{\"content_id\": ", f);
+    fclose(f);
+    assert_true(catalog_changed(catalog));
+    assert_false(catalog_rebuild(catalog));
+    assert_int_equal(len, catalog->len);
+    assert_non_null(catalog_lookup(catalog, "amd64", "stream.json"));
+    /* not parsed again until it changes again */
+    assert_false(catalog_changed(catalog));
+
+    copy_file(DESKTOP, path);
+    assert_true(catalog_changed(catalog));
+    assert_true(catalog_rebuild(catalog));
+    assert_false(catalog_changed(catalog));
+
+    catalog_free(catalog);
+}
+
+/* one input broken doesn't hold back an update to another */
+static void catalog_updates_beside_broken(void **state)
+{
+    char *other = saprintf("%s/other.json", dir);
+    assert_non_null(other);
+    copy_file(SERVER, path);
+    copy_file(SERVER, other);
+    char *paths[] = {path, other};
+    catalog_t *catalog = catalog_create(2, paths);
+    assert_true(catalog_rebuild(catalog));
+
+    FILE *f = fopen(path, "w");
+    assert_non_null(f);
+    fputs("{\"content_id\": ", f);
+    fclose(f);
+    copy_file(DESKTOP, other);
+    assert_true(catalog_changed(catalog));
+    assert_false(catalog_rebuild(catalog));
+    assert_false(catalog_changed(catalog));
+
+    /* the update is served, and the broken input as it last parsed */
+    const catalog_entry_t *entry = catalog_lookup(catalog, "amd64",
+                                                  "other.json");
+    assert_non_null(entry);
+    assert_non_null(strstr(entry->body, "\"com.ubuntu.releases:ubuntu\""));
+    entry = catalog_lookup(catalog, "amd64", "stream.json");
+    assert_non_null(entry);
+    assert_non_null(strstr(entry->body,
+                           "\"com.ubuntu.releases:ubuntu-server\""));
+
+    catalog_free(catalog);
+    unlink(other);
+    free(other);
+}
+
+static void catalog_missing_input(void **state)
+{
+    char *paths[] = {"/not/exist"};
+    catalog_t *catalog = catalog_create(1, paths);
+    assert_true(catalog_changed(catalog));
+    assert_false(catalog_rebuild(catalog));
+    assert_int_equal(0, catalog->len);
+    assert_false(catalog_changed(catalog));
+    catalog_free(catalog);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(catalog_build),
+        cmocka_unit_test(catalog_rebuild_on_change),
+        cmocka_unit_test(catalog_keeps_last_good),
+        cmocka_unit_test(catalog_updates_beside_broken),
+        cmocka_unit_test(catalog_missing_input),
+    };
+    return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,165 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dedupe.h"
+#include "json.h"
+
+#define SUM_A "aaaa000000000000000000000000000000000000000000000000000000000000"
+#define SUM_B "bbbb000000000000000000000000000000000000000000000000000000000000"
+
+static iso_data_t *iso(const char *label, const char *url, const char *sum,
+                       int64_t size)
+{
+    return iso_data_create(strdup(label), strdup(url), strdup(sum), size);
+}
+
+static void dedupe_distinct(void **state)
+{
+    choices_t *choices = choices_create(4);
+    dedupe_t *dedupe = dedupe_create(choices, NULL);
+    assert_true(dedupe_append(dedupe, iso("a", "http://x/a.iso", SUM_A, 1)));
+    assert_true(dedupe_append(dedupe, iso("b", "http://x/b.iso", SUM_B, 1)));
+    assert_int_equal(2, choices->len);
+    dedupe_free(dedupe);
+    choices_free(choices);
+}
+
+static void dedupe_by_sum(void **state)
+{
+    choices_t *choices = choices_create(4);
+    dedupe_t *dedupe = dedupe_create(choices, NULL);
+    assert_true(dedupe_append(dedupe,
+                              iso("a", "http://up/a.iso", SUM_A, 10)));
+    /* case of the sum, name and size don't matter */
+    char *upper = strdup(SUM_A);
+    upper[0] = upper[1] = 'A';
+    assert_true(dedupe_append(dedupe,
+                              iso("a2", "http://mirror/renamed.iso", upper,
+                                  10)));
+    free(upper);
+    assert_int_equal(1, choices->len);
+
+    /* the first found is kept without a policy, the other is a mirror */
+    assert_string_equal("a", choices->values[0]->label);
+    assert_string_equal("http://up/a.iso", choices->values[0]->url);
+    assert_string_equal("http://mirror/renamed.iso",
+                        choices->values[0]->mirrors);
+    dedupe_free(dedupe);
+    choices_free(choices);
+}
+
+static void dedupe_same_name_other_sum(void **state)
+{
+    choices_t *choices = choices_create(4);
+    dedupe_t *dedupe = dedupe_create(choices, NULL);
+    assert_true(dedupe_append(dedupe, iso("a", "http://x/a.iso", SUM_A, 10)));
+    assert_true(dedupe_append(dedupe, iso("b", "http://y/a.iso", SUM_B, 10)));
+    assert_int_equal(2, choices->len);
+    dedupe_free(dedupe);
+    choices_free(choices);
+}
+
+static void dedupe_by_name_without_sum(void **state)
+{
+    choices_t *choices = choices_create(4);
+    dedupe_t *dedupe = dedupe_create(choices, NULL);
+    assert_true(dedupe_append(dedupe, iso("a", "http://x/a.iso", "", 10)));
+    assert_true(dedupe_append(dedupe, iso("a", "http://y/a.iso", SUM_A, 10)));
+    assert_true(dedupe_append(dedupe, iso("c", "http://y/a.iso", "", 11)));
+    assert_int_equal(2, choices->len);
+    /* the sum found later is kept */
+    assert_string_equal(SUM_A, choices->values[0]->sha256sum);
+    assert_string_equal("http://y/a.iso", choices->values[0]->mirrors);
+    dedupe_free(dedupe);
+    choices_free(choices);
+}
+
+static void dedupe_preferred_source(void **state)
+{
+    policy_t *policy = policy_create();
+    policy->prefer[policy->num_prefer++] = strdup("http://local/");
+    policy->prefer[policy->num_prefer++] = strdup("http://near/");
+
+    choices_t *choices = choices_create(4);
+    dedupe_t *dedupe = dedupe_create(choices, policy);
+    assert_true(dedupe_append(dedupe, iso("a", "http://far/a.iso", SUM_A, 1)));
+    assert_true(dedupe_append(dedupe,
+                              iso("a", "http://near/a.iso", SUM_A, 1)));
+    assert_string_equal("http://near/a.iso", choices->values[0]->url);
+    assert_true(dedupe_append(dedupe,
+                              iso("a", "http://local/a.iso", SUM_A, 1)));
+    assert_true(dedupe_append(dedupe, iso("a", "http://far/a.iso", SUM_A, 1)));
+    assert_int_equal(1, choices->len);
+    assert_string_equal("http://local/a.iso", choices->values[0]->url);
+    assert_string_equal("http://far/a.iso http://near/a.iso",
+                        choices->values[0]->mirrors);
+
+    dedupe_free(dedupe);
+    choices_free(choices);
+    policy_free(policy);
+}
+
+static void dedupe_indexes_existing(void **state)
+{
+    choices_t *choices = choices_create(4);
+    choices_append(choices, iso("a", "http://x/a.iso", SUM_A, 1));
+    dedupe_t *dedupe = dedupe_create(choices, NULL);
+    assert_true(dedupe_append(dedupe, iso("a", "http://y/a.iso", SUM_A, 1)));
+    assert_int_equal(1, choices->len);
+    dedupe_free(dedupe);
+    choices_free(choices);
+}
+
+static void dedupe_full(void **state)
+{
+    choices_t *choices = choices_create(1);
+    dedupe_t *dedupe = dedupe_create(choices, NULL);
+    assert_true(dedupe_append(dedupe, iso("a", "http://x/a.iso", SUM_A, 1)));
+    iso_data_t *b = iso("b", "http://x/b.iso", SUM_B, 1);
+    assert_false(dedupe_append(dedupe, b));
+    iso_data_free(b);
+    /* duplicates still merge when full */
+    assert_true(dedupe_append(dedupe, iso("a", "http://y/a.iso", SUM_A, 1)));
+    dedupe_free(dedupe);
+    choices_free(choices);
+}
+
+static void dedupe_streams(void **state)
+{
+    /* the same stream twice, as from a mirror and upstream */
+    const char *filename = "test/data/com.ubuntu.releases:ubuntu-server.json";
+    choices_t *choices = choices_create(10);
+    dedupe_t *dedupe = dedupe_create(choices, NULL);
+    for(int i = 0; i < 2; i++) {
+        choices_t *found = choices_create(10);
+        choices_extend_from_json(found, filename, "amd64");
+        for(int j = 0; j < found->len; j++) {
+            assert_true(dedupe_append(dedupe, found->values[j]));
+        }
+        found->len = 0;
+        choices_free(found);
+    }
+    assert_int_equal(2, choices->len);
+    assert_null(choices->values[0]->mirrors);
+    dedupe_free(dedupe);
+    choices_free(choices);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(dedupe_distinct),
+        cmocka_unit_test(dedupe_by_sum),
+        cmocka_unit_test(dedupe_same_name_other_sum),
+        cmocka_unit_test(dedupe_by_name_without_sum),
+        cmocka_unit_test(dedupe_preferred_source),
+        cmocka_unit_test(dedupe_indexes_existing),
+        cmocka_unit_test(dedupe_full),
+        cmocka_unit_test(dedupe_streams),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,122 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "font.h"
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    assert_non_null(f);
+    uint8_t *data = malloc(65536);
+    assert_non_null(data);
+    *len = fread(data, 1, 65536, f);
+    fclose(f);
+    return data;
+}
+
+static void subiquity_psf(void **state)
+{
+    size_t len = 0;
+    uint8_t *data = read_file("share/subiquity.psf", &len);
+    font_t *font = font_parse(data, len);
+    assert_non_null(font);
+    assert_int_equal(8, font->width);
+    assert_int_equal(16, font->height);
+    assert_int_equal(512, font->charcount);
+    assert_int_equal(16, font->charsize);
+    assert_true(font->glyphs == data + 4);
+
+    /* what the menu draws: text, half blocks and the arrow */
+    assert_true(font_glyph_for(font, 'A') >= 0);
+    assert_true(font_glyph_for(font, 0x2580) >= 0);
+    assert_true(font_glyph_for(font, 0x2584) >= 0);
+    assert_true(font_glyph_for(font, 0x25B6) >= 0
+                || font_glyph_for(font, 0x2192) >= 0);
+    assert_int_equal(-1, font_glyph_for(font, 0x1F600));
+
+    font_free(font);
+    free(data);
+}
+
+/* two 8x2 glyphs, the second showing U+00E9 and U+0065 U+0301 */
+static const uint8_t psf2[] = {
+    0x72, 0xb5, 0x4a, 0x86, 0, 0, 0, 0, 32, 0, 0, 0, 1, 0, 0, 0,
+    2, 0, 0, 0, 2, 0, 0, 0, 2, 0, 0, 0, 8, 0, 0, 0,
+    0x18, 0x18, 0x3c, 0x3c,
+    'A', 'a', 0xff,
+    0xc3, 0xa9, 0xfe, 'e', 0xcc, 0x81, 0xff,
+};
+
+static void psf2_table(void **state)
+{
+    font_t *font = font_parse(psf2, sizeof(psf2));
+    assert_non_null(font);
+    assert_int_equal(8, font->width);
+    assert_int_equal(2, font->height);
+    assert_int_equal(2, font->charcount);
+    assert_true(font->glyphs == psf2 + 32);
+    assert_int_equal(3, font->num_unipairs);
+    assert_int_equal(0, font_glyph_for(font, 'A'));
+    assert_int_equal(0, font_glyph_for(font, 'a'));
+    assert_int_equal(1, font_glyph_for(font, 0xe9));
+    /* only part of a sequence */
+    assert_int_equal(-1, font_glyph_for(font, 'e'));
+    font_free(font);
+}
+
+static void truncated(void **state)
+{
+    for(size_t len = 0; len < sizeof(psf2); len++) {
+        assert_null(font_parse(psf2, len));
+    }
+
+    size_t len = 0;
+    uint8_t *data = read_file("share/subiquity.psf", &len);
+    assert_null(font_parse(data, 3));
+    assert_null(font_parse(data, 4 + 512 * 16 - 1));
+    /* the unicode table ends early */
+    assert_null(font_parse(data, len - 1));
+    free(data);
+}
+
+static void not_a_font(void **state)
+{
+    uint8_t data[64] = "not a font";
+    assert_null(font_parse(data, sizeof(data)));
+    assert_null(font_parse(NULL, 0));
+
+    /* glyphs taller than the console takes */
+    uint8_t tall[4 + 256 * 33] = {0x36, 0x04, 0x00, 33};
+    assert_null(font_parse(tall, sizeof(tall)));
+}
+
+static void load_not_a_console(void **state)
+{
+    font_t *font = font_parse(psf2, sizeof(psf2));
+    assert_non_null(font);
+    int fd = open("/dev/null", O_RDWR);
+    assert_true(fd >= 0);
+    assert_false(font_load_console(fd, font));
+    assert_false(font_load_console(fd, NULL));
+    close(fd);
+    font_free(font);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(subiquity_psf),
+        cmocka_unit_test(psf2_table),
+        cmocka_unit_test(truncated),
+        cmocka_unit_test(not_a_font),
+        cmocka_unit_test(load_not_a_console),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,136 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "iso9660.h"
+
+#define KERNEL "not really a kernel\n"
+#define INITRD "not really an initrd either\n"
+
+static char tmpdir[] = "/tmp/test_iso9660.XXXXXX";
+
+static void write_file(const char *path, const char *contents)
+{
+    FILE *f = fopen(path, "w");
+    assert_non_null(f);
+    fputs(contents, f);
+    fclose(f);
+}
+
+/* build an image with xorriso, with or without Rock Ridge names */
+static int make_iso(const char *name, const char *mkisofs_args)
+{
+    if(system("command -v xorriso > /dev/null") != 0) skip();
+
+    char *casper = saprintf("%s/tree/casper", tmpdir);
+    char *cmd = saprintf("mkdir -p %s", casper);
+    assert_int_equal(0, system(cmd));
+    free(cmd);
+
+    char *path = saprintf("%s/vmlinuz", casper);
+    write_file(path, KERNEL);
+    free(path);
+    path = saprintf("%s/initrd", casper);
+    write_file(path, INITRD);
+    free(path);
+    free(casper);
+
+    char *iso = saprintf("%s/%s", tmpdir, name);
+    cmd = saprintf("xorriso -as mkisofs %s -quiet -o %s %s/tree",
+                   mkisofs_args, iso, tmpdir);
+    assert_int_equal(0, system(cmd));
+    free(cmd);
+
+    int fd = open(iso, O_RDONLY);
+    assert_true(fd >= 0);
+    free(iso);
+    return fd;
+}
+
+static void assert_extent_contents(int fd, const char *path,
+                                   const char *expected)
+{
+    iso_extent_t extent = {};
+    assert_true(iso9660_find(fd, path, &extent));
+    assert_int_equal(strlen(expected), extent.size);
+
+    char buf[64] = {};
+    assert_int_equal(extent.size, pread(fd, buf, extent.size, extent.offset));
+    assert_string_equal(expected, buf);
+}
+
+static int setup(void **state)
+{
+    return mkdtemp(tmpdir) ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+    char *cmd = saprintf("rm -rf %s", tmpdir);
+    int rv = system(cmd);
+    free(cmd);
+    return rv;
+}
+
+static void find_NULL(void **state)
+{
+    iso_extent_t extent = {};
+    assert_false(iso9660_find(-1, "casper/vmlinuz", &extent));
+}
+
+static void find_not_iso(void **state)
+{
+    iso_extent_t extent = {};
+    int fd = open("test/data/empty-obj.json", O_RDONLY);
+    assert_true(fd >= 0);
+    assert_false(iso9660_find(fd, "casper/vmlinuz", &extent));
+    close(fd);
+}
+
+static void find_rock_ridge(void **state)
+{
+    int fd = make_iso("rr.iso", "-R");
+    assert_extent_contents(fd, "casper/vmlinuz", KERNEL);
+    assert_extent_contents(fd, "casper/initrd", INITRD);
+    assert_extent_contents(fd, "/casper//initrd", INITRD);
+    close(fd);
+}
+
+static void find_plain(void **state)
+{
+    int fd = make_iso("plain.iso", "");
+    assert_extent_contents(fd, "casper/vmlinuz", KERNEL);
+    assert_extent_contents(fd, "casper/initrd", INITRD);
+    close(fd);
+}
+
+static void find_missing(void **state)
+{
+    iso_extent_t extent = {};
+    int fd = make_iso("missing.iso", "-R");
+    assert_false(iso9660_find(fd, "casper/vmlinuz.efi", &extent));
+    assert_false(iso9660_find(fd, "boot/vmlinuz", &extent));
+    assert_false(iso9660_find(fd, "casper/vmlinuz/initrd", &extent));
+    /* directories are not files */
+    assert_false(iso9660_find(fd, "casper", &extent));
+    close(fd);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(find_NULL),
+        cmocka_unit_test(find_not_iso),
+        cmocka_unit_test(find_rock_ridge),
+        cmocka_unit_test(find_plain),
+        cmocka_unit_test(find_missing),
+    };
+    return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -2,6 +2,7 @@
 #include <stddef.h>
 #include <setjmp.h>
 #include <cmocka.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <json-c/json.h>
@@ -270,6 +271,175 @@ static void read_ubuntu_desktop_releases(void **state)
             4071903232);
 }
 
+static void mirrors_load(void **state)
+{
+    criteria_t *criteria =
+        criteria_for_content_id("com.ubuntu.releases:ubuntu-server");
+    assert_int_equal(0, criteria->num_mirrors);
+
+    assert_int_equal(2, criteria_load_mirrors("test/data/mirrors"));
+    assert_int_equal(2, criteria->num_mirrors);
+    assert_string_equal("http://mirror.example.com/ubuntu-releases",
+                        criteria->mirrors[0]);
+    assert_string_equal("https://mirror2.example.com/releases",
+                        criteria->mirrors[1]);
+
+    choices_t *choices = choices_create(2);
+    choices_extend_from_json(choices,
+            "test/data/com.ubuntu.releases:ubuntu-server.json", "amd64");
+    assert_string_equal(
+            "http://mirror.example.com/ubuntu-releases/kinetic/ubuntu-22.10-live-server-amd64.iso "
+            "https://mirror2.example.com/releases/kinetic/ubuntu-22.10-live-server-amd64.iso",
+            choices->values[1]->mirrors);
+
+    for(int i = 0; i < criteria->num_mirrors; i++) {
+        free(criteria->mirrors[i]);
+    }
+    criteria->num_mirrors = 0;
+}
+
+static void mirrors_load_missing(void **state)
+{
+    assert_int_equal(-1, criteria_load_mirrors("/not/exist"));
+}
+
+static void mirrors_add_unknown(void **state)
+{
+    assert_false(criteria_add_mirror("com.ubuntu.bogus", "http://a"));
+    assert_false(criteria_add_mirror(NULL, "http://a"));
+}
+
+static void mirrors_add_full(void **state)
+{
+    const char *content_id = "com.ubuntu.cdimage.daily:ubuntu";
+    criteria_t *criteria = criteria_for_content_id(content_id);
+    for(int i = 0; i < MAX_MIRRORS; i++) {
+        assert_true(criteria_add_mirror(content_id, "http://a"));
+    }
+    assert_false(criteria_add_mirror(content_id, "http://a"));
+
+    for(int i = 0; i < criteria->num_mirrors; i++) {
+        free(criteria->mirrors[i]);
+    }
+    criteria->num_mirrors = 0;
+}
+
+static void mirrors_none(void **state)
+{
+    choices_t *choices = choices_create(2);
+    choices_extend_from_json(choices,
+            "test/data/com.ubuntu.releases:ubuntu-server.json", "amd64");
+    assert_null(choices->values[1]->mirrors);
+}
+
+static bool count_iso_item(void *ctx, const char *path, const char *sha256,
+                           int64_t size)
+{
+    int *count = ctx;
+    assert_non_null(path);
+    assert_int_equal(64, strlen(sha256));
+    assert_true(size > 0);
+    (*count)++;
+    return true;
+}
+
+static bool first_iso_item(void *ctx, const char *path, const char *sha256,
+                           int64_t size)
+{
+    int *count = ctx;
+    (*count)++;
+    return false;
+}
+
+static void iso_items_all(void **state)
+{
+    json_object *root = stream_from_file(
+            "test/data/com.ubuntu.releases:ubuntu-server.json");
+    int count = 0;
+    assert_true(foreach_iso_item(root, count_iso_item, &count));
+    /* every version of every arch, and no other ftype */
+    assert_int_equal(9, count);
+    json_object_put(root);
+}
+
+static void iso_items_stop(void **state)
+{
+    json_object *root = stream_from_file(
+            "test/data/com.ubuntu.releases:ubuntu-server.json");
+    int count = 0;
+    assert_false(foreach_iso_item(root, first_iso_item, &count));
+    assert_int_equal(1, count);
+    json_object_put(root);
+}
+
+static void iso_items_NULL(void **state)
+{
+    int count = 0;
+    assert_false(foreach_iso_item(NULL, count_iso_item, &count));
+    assert_int_equal(0, count);
+}
+
+static void _test_prune(const char *filename, const char *arch)
+{
+    json_object *root = stream_from_file(filename);
+    assert_non_null(root);
+    json_object *pruned = prune_stream(root, arch);
+    assert_non_null(pruned);
+
+    /* only the newest iso item is left of each product */
+    int products = 0;
+    json_object_object_foreach(get(pruned, "products"), key, product) {
+        (void)key;
+        products++;
+        if(arch) assert_string_equal(arch, str(get(product, "arch")));
+        json_object *versions = get(product, "versions");
+        assert_int_equal(1, json_object_object_length(versions));
+        json_object *items = get(find_largest_key(versions, NULL), "items");
+        assert_int_equal(1, json_object_object_length(items));
+        assert_non_null(get(items, "iso"));
+    }
+    assert_true(products > 0);
+
+    /* and the menu finds the same choices in it */
+    choices_t *expected = choices_create(10);
+    choices_t *actual = choices_create(10);
+    assert_true(choices_extend_from_root(expected, root, "amd64"));
+    assert_true(choices_extend_from_root(actual, pruned, "amd64"));
+    assert_int_equal(expected->len, actual->len);
+    for(int i = 0; i < expected->len; i++) {
+        assert_string_equal(expected->values[i]->label,
+                            actual->values[i]->label);
+        assert_string_equal(expected->values[i]->url,
+                            actual->values[i]->url);
+        assert_string_equal(expected->values[i]->sha256sum,
+                            actual->values[i]->sha256sum);
+        assert_int_equal(expected->values[i]->size, actual->values[i]->size);
+    }
+
+    choices_free(expected);
+    choices_free(actual);
+    json_object_put(pruned);
+    json_object_put(root);
+}
+
+static void prune_server_cdimage(void **state)
+{
+    _test_prune("test/data/com.ubuntu.cdimage.daily:ubuntu-server.json",
+                "amd64");
+}
+
+static void prune_desktop_releases(void **state)
+{
+    _test_prune("test/data/com.ubuntu.releases:ubuntu.json", NULL);
+}
+
+static void prune_unknown(void **state)
+{
+    json_object *root = stream_from_file("test/data/empty-obj.json");
+    assert_null(prune_stream(root, "amd64"));
+    json_object_put(root);
+}
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
@@ -287,6 +457,20 @@ int main(void)
         cmocka_unit_test(read_ubuntu_desktop_cdimage),
         cmocka_unit_test(read_ubuntu_desktop_releases),
 
+        cmocka_unit_test(mirrors_load),
+        cmocka_unit_test(mirrors_load_missing),
+        cmocka_unit_test(mirrors_add_unknown),
+        cmocka_unit_test(mirrors_add_full),
+        cmocka_unit_test(mirrors_none),
+
+        cmocka_unit_test(iso_items_all),
+        cmocka_unit_test(iso_items_stop),
+        cmocka_unit_test(iso_items_NULL),
+
+        cmocka_unit_test(prune_server_cdimage),
+        cmocka_unit_test(prune_desktop_releases),
+        cmocka_unit_test(prune_unknown),
+
         cmocka_unit_test(eq_NULL),
         cmocka_unit_test(eq_good),
         cmocka_unit_test(eq_bad),
@@ -0,0 +1,204 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <json-c/json.h>
+
+#include "json.h"
+#include "policy.h"
+
+static char path[] = "/tmp/test_policy.XXXXXX";
+
+static int setup(void **state)
+{
+    int fd = mkstemp(path);
+    if(fd == -1) return -1;
+    close(fd);
+    return 0;
+}
+
+static int teardown(void **state)
+{
+    set_policy(NULL);
+    return unlink(path);
+}
+
+static policy_t *load(const char *text)
+{
+    FILE *f = fopen(path, "w");
+    assert_non_null(f);
+    fputs(text, f);
+    fclose(f);
+    return policy_load(path);
+}
+
+static json_object *product(const char *release, const char *title,
+                            const char *os)
+{
+    json_object *ret = json_object_new_object();
+    json_object_object_add(ret, "release", json_object_new_string(release));
+    json_object_object_add(ret, "release_title",
+                           json_object_new_string(title));
+    json_object_object_add(ret, "os", json_object_new_string(os));
+    return ret;
+}
+
+static void policy_defaults(void **state)
+{
+    policy_t *policy = policy_create();
+    assert_string_equal(MINIMUM_UBUNTU_VERSION, policy->minimum_version);
+    assert_int_equal(0, policy->num_series);
+    assert_int_equal(0, policy->num_flavours);
+    assert_false(policy->lts_only);
+    assert_int_equal(0, policy->num_order);
+    policy_free(policy);
+}
+
+static void policy_load_file(void **state)
+{
+    policy_t *policy = load("# comment\n"
+                            "\n"
+                            "minimum_version=23.04\n"
+                            "series=lunar,mantic\n"
+                            "flavours=ubuntu-server\n"
+                            "lts_only=yes\n"
+                            "order=lts,-version,label\n"
+                            "prefer=http://local/,http://near/\n");
+    assert_non_null(policy);
+    assert_string_equal("23.04", policy->minimum_version);
+    assert_int_equal(2, policy->num_series);
+    assert_string_equal("lunar", policy->series[0]);
+    assert_string_equal("mantic", policy->series[1]);
+    assert_int_equal(1, policy->num_flavours);
+    assert_string_equal("ubuntu-server", policy->flavours[0]);
+    assert_true(policy->lts_only);
+    assert_int_equal(3, policy->num_order);
+    assert_int_equal(POLICY_KEY_LTS, policy->order[0].key);
+    assert_false(policy->order[0].descending);
+    assert_int_equal(POLICY_KEY_VERSION, policy->order[1].key);
+    assert_true(policy->order[1].descending);
+    assert_int_equal(POLICY_KEY_LABEL, policy->order[2].key);
+    assert_int_equal(0, policy_source_rank(policy, "http://local/a.iso"));
+    assert_int_equal(1, policy_source_rank(policy, "http://near/a.iso"));
+    assert_int_equal(2, policy_source_rank(policy, "http://far/a.iso"));
+    policy_free(policy);
+}
+
+static void policy_load_invalid(void **state)
+{
+    assert_null(load("colour=orange\n"));
+    assert_null(load("lts_only=maybe\n"));
+    assert_null(load("order=size\n"));
+    assert_null(load("order=version,version,version,version,version\n"));
+    assert_null(load("series\n"));
+    /* below what the kernel modules allow */
+    assert_null(load("minimum_version=20.04\n"));
+    assert_null(policy_load("/not/exist"));
+}
+
+static void policy_allows_default(void **state)
+{
+    json_object *old = product("focal", "20.04.6 LTS", "ubuntu");
+    json_object *new = product("jammy", "22.04.2 LTS", "ubuntu");
+    assert_false(policy_allows(NULL, old));
+    assert_true(policy_allows(NULL, new));
+    json_object_put(old);
+    json_object_put(new);
+}
+
+static void policy_allows_filters(void **state)
+{
+    policy_t *policy = load("series=jammy,lunar\n"
+                            "flavours=ubuntu-server\n"
+                            "lts_only=true\n");
+    json_object *jammy = product("jammy", "22.04.2 LTS", "ubuntu-server");
+    json_object *desktop = product("jammy", "22.04.2 LTS", "ubuntu");
+    json_object *lunar = product("lunar", "23.04", "ubuntu-server");
+    json_object *noble = product("noble", "24.04 LTS", "ubuntu-server");
+    assert_true(policy_allows(policy, jammy));
+    assert_false(policy_allows(policy, desktop));
+    assert_false(policy_allows(policy, lunar));
+    assert_false(policy_allows(policy, noble));
+    json_object_put(jammy);
+    json_object_put(desktop);
+    json_object_put(lunar);
+    json_object_put(noble);
+    policy_free(policy);
+}
+
+static void policy_applied_while_parsing(void **state)
+{
+    policy_t *policy = load("minimum_version=22.10\n");
+    set_policy(policy);
+    choices_t *choices = choices_create(10);
+    choices_extend_from_json(choices,
+            "test/data/com.ubuntu.releases:ubuntu-server.json", "amd64");
+    assert_int_equal(1, choices->len);
+    assert_string_equal("Ubuntu Server 22.10 (Kinetic Kudu)",
+                        choices->values[0]->label);
+    choices_free(choices);
+    set_policy(NULL);
+    policy_free(policy);
+}
+
+static iso_data_t *iso(const char *label, const char *version,
+                       const char *os)
+{
+    iso_data_t *ret = iso_data_create(strdup(label), strdup(""), strdup(""),
+                                      0);
+    ret->version = strdup(version);
+    ret->os = strdup(os);
+    return ret;
+}
+
+static void policy_sort_order(void **state)
+{
+    policy_t *policy = load("flavours=ubuntu-server,ubuntu\n"
+                            "order=flavour,-lts,-version\n");
+    choices_t *choices = choices_create(5);
+    choices_append(choices, iso("a", "22.10", "ubuntu"));
+    choices_append(choices, iso("b", "22.04.2 LTS", "ubuntu-server"));
+    choices_append(choices, iso("c", "22.04.2 LTS", "ubuntu"));
+    choices_append(choices, iso("d", "23.04", "ubuntu-server"));
+    choices_append(choices, iso("e", "23.04", "ubuntu-server"));
+
+    policy_sort(policy, choices);
+    const char *expected[] = {"b", "d", "e", "c", "a"};
+    for(int i = 0; i < 5; i++) {
+        assert_string_equal(expected[i], choices->values[i]->label);
+    }
+
+    choices_free(choices);
+    policy_free(policy);
+}
+
+static void policy_sort_none(void **state)
+{
+    choices_t *choices = choices_create(2);
+    choices_append(choices, iso("b", "22.10", "ubuntu"));
+    choices_append(choices, iso("a", "22.04.2 LTS", "ubuntu"));
+    policy_sort(NULL, choices);
+    assert_string_equal("b", choices->values[0]->label);
+    assert_string_equal("a", choices->values[1]->label);
+    choices_free(choices);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(policy_defaults),
+        cmocka_unit_test(policy_load_file),
+        cmocka_unit_test(policy_load_invalid),
+        cmocka_unit_test(policy_allows_default),
+        cmocka_unit_test(policy_allows_filters),
+        cmocka_unit_test(policy_applied_while_parsing),
+        cmocka_unit_test(policy_sort_order),
+        cmocka_unit_test(policy_sort_none),
+    };
+    return cmocka_run_group_tests(tests, setup, teardown);
+}
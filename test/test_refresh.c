@@ -0,0 +1,193 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "refresh.h"
+
+static iso_data_t *make_iso(const char *os, const char *version,
+                            const char *codename, const char *sum)
+{
+    iso_data_t *iso = iso_data_create(
+            saprintf("Ubuntu Server %s (%s)", version, codename),
+            saprintf("https://releases.ubuntu.com/%s.iso", version),
+            strdup(sum), 1000);
+    iso->os = strdup(os);
+    iso->version = strdup(version);
+    return iso;
+}
+
+static choices_t *jammy_and_noble(const char *jammy, const char *noble)
+{
+    choices_t *choices = choices_create(4);
+    choices_append(choices, make_iso("ubuntu-server", noble,
+                                     "Noble Numbat", "aa"));
+    choices_append(choices, make_iso("ubuntu-server", jammy,
+                                     "Jammy Jellyfish", "bb"));
+    return choices;
+}
+
+static char *write_marker(const char *content)
+{
+    char *path = strdup("/tmp/test_refresh.XXXXXX");
+    int fd = mkstemp(path);
+    assert_int_not_equal(-1, fd);
+    FILE *f = fdopen(fd, "w");
+    fputs(content, f);
+    fclose(f);
+    return path;
+}
+
+static void marker_missing(void **state)
+{
+    int num = -1;
+    assert_null(refresh_read_marker("/nonexistent/ready", &num));
+    assert_int_equal(-1, num);
+}
+
+static void marker_empty(void **state)
+{
+    char *path = write_marker("");
+    int num = -1;
+    char **streams = refresh_read_marker(path, &num);
+    assert_non_null(streams);
+    assert_int_equal(0, num);
+    assert_null(streams[0]);
+    refresh_free_streams(streams);
+    unlink(path);
+    free(path);
+}
+
+static void marker_streams(void **state)
+{
+    char *path = write_marker("/tmp/a.json\n\n/tmp/b.json\n/tmp/c.json\n"
+                              "/tmp/d.json\n/tmp/e.json");
+    int num = 0;
+    char **streams = refresh_read_marker(path, &num);
+    assert_non_null(streams);
+    assert_int_equal(5, num);
+    assert_string_equal("/tmp/a.json", streams[0]);
+    assert_string_equal("/tmp/b.json", streams[1]);
+    assert_string_equal("/tmp/e.json", streams[4]);
+    assert_null(streams[5]);
+    refresh_free_streams(streams);
+    unlink(path);
+    free(path);
+}
+
+static void unchanged(void **state)
+{
+    choices_t *choices = jammy_and_noble("22.04.3 LTS", "24.04 LTS");
+    choices->cur = 1;
+    assert_true(choices_refresh(choices,
+                                jammy_and_noble("22.04.3 LTS", "24.04 LTS")));
+    assert_int_equal(2, choices->len);
+    assert_int_equal(1, choices->cur);
+    choices_free(choices);
+}
+
+static void point_release(void **state)
+{
+    choices_t *choices = jammy_and_noble("22.04.3 LTS", "24.04 LTS");
+    choices->cur = 1;
+
+    /* the selection follows jammy, though it is another image */
+    choices_t *fresh = choices_create(4);
+    choices_append(fresh, make_iso("ubuntu-server", "22.04.4 LTS",
+                                   "Jammy Jellyfish", "cc"));
+    choices_append(fresh, make_iso("ubuntu-server", "24.04 LTS",
+                                   "Noble Numbat", "aa"));
+    assert_false(choices_refresh(choices, fresh));
+    assert_int_equal(0, choices->cur);
+    assert_string_equal("22.04.4 LTS", choices->values[0]->version);
+    choices_free(choices);
+}
+
+static void other_selection_changed(void **state)
+{
+    choices_t *choices = jammy_and_noble("22.04.3 LTS", "24.04 LTS");
+    choices->cur = 0;
+    assert_true(choices_refresh(choices,
+                                jammy_and_noble("22.04.4 LTS", "24.04 LTS")));
+    assert_int_equal(0, choices->cur);
+    assert_string_equal("22.04.4 LTS", choices->values[1]->version);
+    choices_free(choices);
+}
+
+static void selection_gone(void **state)
+{
+    choices_t *choices = jammy_and_noble("22.04.3 LTS", "24.04 LTS");
+    choices->cur = 1;
+    choices_t *fresh = choices_create(4);
+    choices_append(fresh, make_iso("ubuntu-server", "24.10",
+                                   "Oracular Oriole", "dd"));
+    choices_append(fresh, make_iso("ubuntu-server", "24.04 LTS",
+                                   "Noble Numbat", "aa"));
+    assert_false(choices_refresh(choices, fresh));
+    assert_int_equal(2, choices->len);
+    assert_int_equal(0, choices->cur);
+    choices_free(choices);
+}
+
+static void flavour_differs(void **state)
+{
+    choices_t *choices = jammy_and_noble("22.04.3 LTS", "24.04 LTS");
+    choices->cur = 1;
+    choices_t *fresh = choices_create(4);
+    choices_append(fresh, make_iso("ubuntu-server", "24.04 LTS",
+                                   "Noble Numbat", "aa"));
+    choices_append(fresh, make_iso("ubuntu", "22.04.3 LTS",
+                                   "Jammy Jellyfish", "ee"));
+    free(fresh->values[1]->label);
+    fresh->values[1]->label = strdup("Ubuntu Desktop 22.04.3 LTS");
+    assert_false(choices_refresh(choices, fresh));
+    assert_int_equal(0, choices->cur);
+    choices_free(choices);
+}
+
+static void empty_fresh(void **state)
+{
+    choices_t *choices = jammy_and_noble("22.04.3 LTS", "24.04 LTS");
+    choices->cur = 1;
+    assert_true(choices_refresh(choices, choices_create(4)));
+    assert_int_equal(2, choices->len);
+    assert_int_equal(1, choices->cur);
+    assert_string_equal("22.04.3 LTS", choices->values[1]->version);
+    choices_free(choices);
+}
+
+static void same_image(void **state)
+{
+    iso_data_t *a = make_iso("ubuntu-server", "24.04 LTS", "Noble", "aa");
+    iso_data_t *b = make_iso("ubuntu-server", "24.04 LTS", "Noble", "aa");
+    assert_true(iso_data_same_image(a, b));
+    b->size++;
+    assert_false(iso_data_same_image(a, b));
+    b->size--;
+    free(b->sha256sum);
+    b->sha256sum = strdup("ab");
+    assert_false(iso_data_same_image(a, b));
+    iso_data_free(a);
+    iso_data_free(b);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(marker_missing),
+        cmocka_unit_test(marker_empty),
+        cmocka_unit_test(marker_streams),
+        cmocka_unit_test(unchanged),
+        cmocka_unit_test(point_release),
+        cmocka_unit_test(other_selection_changed),
+        cmocka_unit_test(selection_gone),
+        cmocka_unit_test(flavour_differs),
+        cmocka_unit_test(empty_fresh),
+        cmocka_unit_test(same_image),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
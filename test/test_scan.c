@@ -0,0 +1,208 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json-c/json.h>
+
+#include "json.h"
+#include "scan.h"
+
+static const char *streams[] = {
+    "test/data/com.ubuntu.cdimage.daily:ubuntu-server.json",
+    "test/data/com.ubuntu.cdimage.daily:ubuntu.json",
+    "test/data/com.ubuntu.releases:ubuntu-server.json",
+    "test/data/com.ubuntu.releases:ubuntu.json",
+    "test/data/empty-obj.json",
+};
+
+#define ARRAY_LEN(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+static json_object *scan_string(const char *data)
+{
+    return scan_stream(data, strlen(data));
+}
+
+static void _test_kernel(const char *name)
+{
+    if(!scan_use_kernel(name)) skip();
+    assert_string_equal(name, scan_kernel_name());
+
+    for(size_t i = 0; i < ARRAY_LEN(streams); i++) {
+        json_object *full = json_object_from_file(streams[i]);
+        json_object *scanned = scan_stream_file(streams[i]);
+        assert_non_null(full);
+        assert_non_null(scanned);
+
+        /* all the menu reads is the same */
+        json_object *expected = prune_stream(full, NULL);
+        json_object *actual = prune_stream(scanned, NULL);
+        assert_true(json_object_equal(expected, actual));
+
+        choices_t *expected_choices = choices_create(10);
+        choices_t *actual_choices = choices_create(10);
+        choices_extend_from_root(expected_choices, full, "amd64");
+        choices_extend_from_root(actual_choices, scanned, "amd64");
+        assert_int_equal(expected_choices->len, actual_choices->len);
+        for(int j = 0; j < expected_choices->len; j++) {
+            assert_string_equal(expected_choices->values[j]->label,
+                                actual_choices->values[j]->label);
+            assert_string_equal(expected_choices->values[j]->url,
+                                actual_choices->values[j]->url);
+            assert_string_equal(expected_choices->values[j]->sha256sum,
+                                actual_choices->values[j]->sha256sum);
+            assert_int_equal(expected_choices->values[j]->size,
+                             actual_choices->values[j]->size);
+        }
+
+        choices_free(expected_choices);
+        choices_free(actual_choices);
+        json_object_put(expected);
+        json_object_put(actual);
+        json_object_put(full);
+        json_object_put(scanned);
+    }
+}
+
+static void kernel_avx2(void **state)
+{
+    _test_kernel("avx2");
+}
+
+static void kernel_sse2(void **state)
+{
+    _test_kernel("sse2");
+}
+
+static void kernel_neon(void **state)
+{
+    _test_kernel("neon");
+}
+
+static void unknown_kernel(void **state)
+{
+    assert_false(scan_use_kernel("bogus"));
+    assert_false(scan_use_kernel(NULL));
+}
+
+static void keeps_read_keys(void **state)
+{
+    if(!scan_kernel_name()) skip();
+    json_object *root = scan_string(
+            "{\"content_id\": \"c\", \"index\": {\"a\": [1, 2]},"
+            " \"products\": {\"p\": {\"arch\": \"amd64\","
+            " \"aliases\": \"x,y\", \"versions\": {\"20230101\": {"
+            " \"label\": \"release\", \"items\": {\"iso\": {"
+            " \"ftype\": \"iso\", \"md5\": \"0\", \"size\": 42},"
+            " \"manifest\": {\"ftype\": \"manifest\"}}}}}}}");
+    assert_non_null(root);
+    assert_string_equal("c",
+                        json_object_get_string(get(root, "content_id")));
+    assert_null(get(root, "index"));
+
+    json_object *product = get(get(root, "products"), "p");
+    assert_string_equal("amd64",
+                        json_object_get_string(get(product, "arch")));
+    assert_null(get(product, "aliases"));
+
+    json_object *version = get(get(product, "versions"), "20230101");
+    assert_null(get(version, "label"));
+    json_object *iso = get(get(version, "items"), "iso");
+    assert_string_equal("iso", json_object_get_string(get(iso, "ftype")));
+    assert_int_equal(42, json_object_get_int64(get(iso, "size")));
+    assert_null(get(iso, "md5"));
+    assert_null(get(get(version, "items"), "manifest"));
+    json_object_put(root);
+}
+
+static void escapes(void **state)
+{
+    if(!scan_kernel_name()) skip();
+    json_object *root = scan_string(
+            "{\"content_id\": \"a\\/b\\\\\\\"\\u00e9\\ud83d\\ude00\\ud800\","
+            " \"for\\u006dat\": \"\\t\"}");
+    assert_non_null(root);
+    assert_string_equal("a/b\\\"\xc3\xa9\xf0\x9f\x98\x80\xef\xbf\xbd",
+                        json_object_get_string(get(root, "content_id")));
+    assert_string_equal("\t", json_object_get_string(get(root, "format")));
+    json_object_put(root);
+}
+
+static void block_boundaries(void **state)
+{
+    if(!scan_kernel_name()) skip();
+
+    /* runs of backslashes and quotes straddling each block boundary */
+    for(int pad = 0; pad < 140; pad++) {
+        for(int run = 1; run <= 4; run++) {
+            char value[256];
+            memset(value, 'x', pad);
+            int len = pad;
+            for(int i = 0; i < run; i++) {
+                value[len++] = '\\';
+                value[len++] = i % 2 ? '"' : '\\';
+            }
+            value[len] = '\0';
+
+            char data[512];
+            snprintf(data, sizeof(data),
+                     "{\"content_id\": \"%s\", \"updated\": 1}", value);
+            json_object *expected = json_tokener_parse(data);
+            json_object *actual = scan_string(data);
+            assert_non_null(actual);
+            assert_true(json_object_equal(expected, actual));
+            json_object_put(expected);
+            json_object_put(actual);
+        }
+    }
+}
+
+static void malformed(void **state)
+{
+    if(!scan_kernel_name()) skip();
+    const char *docs[] = {
+        "", "{", "}", "{\"content_id\": }", "{\"a\" 1}", "{\"a\": 1,}",
+        "[1, 2,]", "{\"a\": \"unterminated}", "{\"updated\": tru}",
+        "{\"updated\": 01}", "{\"a\": 1} {}", "{\"content_id\": \"\\x\"}",
+        "{\"a\": [}", "{\"a\": 1]",
+    };
+    for(size_t i = 0; i < ARRAY_LEN(docs); i++) {
+        assert_null(scan_string(docs[i]));
+    }
+}
+
+static void too_deep(void **state)
+{
+    if(!scan_kernel_name()) skip();
+    char data[256];
+    memset(data, '[', 100);
+    memset(data + 100, ']', 100);
+    data[200] = '\0';
+    assert_null(scan_string(data));
+}
+
+static void missing_file(void **state)
+{
+    assert_null(scan_stream_file("test/data/nonexistent.json"));
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(kernel_avx2),
+        cmocka_unit_test(kernel_sse2),
+        cmocka_unit_test(kernel_neon),
+        cmocka_unit_test(unknown_kernel),
+
+        cmocka_unit_test(keeps_read_keys),
+        cmocka_unit_test(escapes),
+        cmocka_unit_test(block_boundaries),
+        cmocka_unit_test(malformed),
+        cmocka_unit_test(too_deep),
+        cmocka_unit_test(missing_file),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
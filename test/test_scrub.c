@@ -0,0 +1,101 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "scrub.h"
+
+static char dir[] = "/tmp/test_scrub.XXXXXX";
+static char *iso;
+
+static int setup(void **state)
+{
+    if(!mkdtemp(dir)) return -1;
+    iso = saprintf("%s/ubuntu.iso", dir);
+    FILE *f = iso ? fopen(iso, "w") : NULL;
+    if(!f) return -1;
+    fputs("0123456789", f);
+    return fclose(f);
+}
+
+static int teardown(void **state)
+{
+    unlink(iso);
+    free(iso);
+    return rmdir(dir);
+}
+
+/* two versions with the same file name, the file being the second */
+static void scrub_same_basename(void **state)
+{
+    scrub_match_t match = {.dir = dir};
+    assert_true(scrub_add_item(&match, "daily/ubuntu.iso", "aa", 20));
+    assert_true(scrub_add_item(&match, "release/ubuntu.iso", "bb", 10));
+    assert_int_equal(1, match.len);
+    assert_int_equal(2, match.files[0].num_items);
+    assert_int_equal(10, match.files[0].size);
+
+    bool sized = false;
+    const scrub_item_t *item = scrub_pick(&match.files[0], &sized);
+    assert_true(sized);
+    assert_string_equal("release/ubuntu.iso", item->name);
+    assert_string_equal("bb", item->sha256);
+    scrub_match_free(&match);
+}
+
+static void scrub_prefers_exact(void **state)
+{
+    scrub_match_t match = {.dir = dir};
+    assert_true(scrub_add_item(&match, "daily/ubuntu.iso", "aa", 10));
+    assert_true(scrub_add_item(&match, "ubuntu.iso", "bb", 10));
+    assert_int_equal(1, match.len);
+
+    bool sized = false;
+    const scrub_item_t *item = scrub_pick(&match.files[0], &sized);
+    assert_true(sized);
+    assert_true(item->exact);
+    assert_string_equal("ubuntu.iso", item->name);
+    scrub_match_free(&match);
+}
+
+static void scrub_none_fits(void **state)
+{
+    scrub_match_t match = {.dir = dir};
+    assert_true(scrub_add_item(&match, "daily/ubuntu.iso", "aa", 20));
+    assert_true(scrub_add_item(&match, "ubuntu.iso", "bb", 30));
+
+    bool sized = true;
+    const scrub_item_t *item = scrub_pick(&match.files[0], &sized);
+    assert_false(sized);
+    assert_string_equal("ubuntu.iso", item->name);
+    scrub_match_free(&match);
+}
+
+static void scrub_skips_missing(void **state)
+{
+    scrub_match_t match = {.dir = dir};
+    assert_true(scrub_add_item(&match, "daily/other.iso", "aa", 10));
+    assert_int_equal(0, match.len);
+    /* the same item in several streams is checked once */
+    assert_true(scrub_add_item(&match, "release/ubuntu.iso", "bb", 10));
+    assert_true(scrub_add_item(&match, "release/ubuntu.iso", "bb", 10));
+    assert_int_equal(1, match.len);
+    assert_int_equal(1, match.files[0].num_items);
+    scrub_match_free(&match);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(scrub_same_basename),
+        cmocka_unit_test(scrub_prefers_exact),
+        cmocka_unit_test(scrub_none_fits),
+        cmocka_unit_test(scrub_skips_missing),
+    };
+    return cmocka_run_group_tests(tests, setup, teardown);
+}
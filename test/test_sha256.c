@@ -0,0 +1,120 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sha256.h"
+
+static const char *kernel_names[] = {"shani", "armv8", "portable"};
+
+static void assert_digest(const void *data, size_t len, size_t step,
+                          const char *expected)
+{
+    sha256_t ctx;
+    sha256_init(&ctx);
+    for(size_t done = 0; done < len; done += step) {
+        size_t cur = len - done < step ? len - done : step;
+        sha256_update(&ctx, (const char *)data + done, cur);
+    }
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256_final(&ctx, digest);
+
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+    sha256_hex(digest, hex);
+    assert_string_equal(expected, hex);
+}
+
+/* FIPS 180-2 vectors, fed in one piece and in awkward steps */
+static void _test_vectors(const char *name)
+{
+    if(!sha256_use_kernel(name)) skip();
+    assert_string_equal(name, sha256_kernel_name());
+
+    assert_digest("", 0, 1,
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+    for(size_t step = 1; step <= 3; step++) {
+        assert_digest("abc", 3, step,
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    }
+
+    const char *msg =
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    for(size_t step = 1; step <= 64; step += 7) {
+        assert_digest(msg, strlen(msg), step,
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    }
+
+    size_t len = 1000000;
+    char *a = malloc(len);
+    assert_non_null(a);
+    memset(a, 'a', len);
+    assert_digest(a, len, len,
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    assert_digest(a, len, 4093,
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    free(a);
+}
+
+static void vectors_shani(void **state)
+{
+    _test_vectors("shani");
+}
+
+static void vectors_armv8(void **state)
+{
+    _test_vectors("armv8");
+}
+
+static void vectors_portable(void **state)
+{
+    _test_vectors("portable");
+}
+
+static void kernels_agree(void **state)
+{
+    size_t len = 3 * 1024 * 1024 + 17;
+    uint8_t *data = malloc(len);
+    assert_non_null(data);
+    for(size_t i = 0; i < len; i++) {
+        data[i] = (i * 2654435761u) >> 13;
+    }
+
+    char expected[SHA256_DIGEST_SIZE * 2 + 1] = {};
+    for(size_t i = 0; i < sizeof(kernel_names) / sizeof(kernel_names[0]);
+            i++) {
+        if(!sha256_use_kernel(kernel_names[i])) continue;
+        sha256_t ctx;
+        sha256_init(&ctx);
+        sha256_update(&ctx, data, len);
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        sha256_final(&ctx, digest);
+        char hex[SHA256_DIGEST_SIZE * 2 + 1];
+        sha256_hex(digest, hex);
+        if(expected[0]) {
+            assert_string_equal(expected, hex);
+        }
+        strcpy(expected, hex);
+    }
+    free(data);
+}
+
+static void unknown_kernel(void **state)
+{
+    assert_false(sha256_use_kernel("bogus"));
+    assert_non_null(sha256_kernel_name());
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(vectors_shani),
+        cmocka_unit_test(vectors_armv8),
+        cmocka_unit_test(vectors_portable),
+        cmocka_unit_test(kernels_agree),
+        cmocka_unit_test(unknown_kernel),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,233 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "sink.h"
+
+/* not a multiple of the direct I/O alignment, to cover the tail */
+#define DATA_SIZE (9 * 1024 * 1024 + 123)
+
+static uint8_t *data;
+static char path[] = "/tmp/test_sink.XXXXXX";
+
+static int setup(void **state)
+{
+    data = malloc(DATA_SIZE);
+    if(!data) return -1;
+    for(int i = 0; i < DATA_SIZE; i++) {
+        data[i] = i * 7 + i / 4096;
+    }
+    int fd = mkstemp(path);
+    if(fd == -1) return -1;
+    close(fd);
+    return 0;
+}
+
+static int teardown(void **state)
+{
+    free(data);
+    return unlink(path);
+}
+
+/* feed len bytes of src through a pipe into sink_copy() */
+static int64_t sink_bytes(const uint8_t *src, size_t len, sink_t *sink)
+{
+    int pipefd[2];
+    assert_int_equal(0, pipe(pipefd));
+
+    pid_t pid = fork();
+    assert_true(pid >= 0);
+    if(pid == 0) {
+        close(pipefd[0]);
+        size_t done = 0;
+        while(done < len) {
+            ssize_t rv = write(pipefd[1], src + done, len - done);
+            if(rv <= 0) _exit(1);
+            done += rv;
+        }
+        _exit(0);
+    }
+
+    close(pipefd[1]);
+    int64_t ret = sink_copy(pipefd[0], path, sink);
+    close(pipefd[0]);
+    waitpid(pid, NULL, 0);
+    return ret;
+}
+
+static int64_t sink_data(size_t len, sink_t *sink)
+{
+    return sink_bytes(data, len, sink);
+}
+
+static void assert_target_contents(size_t len)
+{
+    struct stat st;
+    assert_int_equal(0, stat(path, &st));
+    assert_int_equal(len, st.st_size);
+
+    uint8_t *buf = malloc(len);
+    assert_non_null(buf);
+    int fd = open(path, O_RDONLY);
+    assert_true(fd >= 0);
+    assert_int_equal(len, read(fd, buf, len));
+    close(fd);
+    assert_memory_equal(data, buf, len);
+    free(buf);
+}
+
+static void _test_strategy(sink_strategy strategy)
+{
+    sink_t sink = {.strategy = strategy, .size = DATA_SIZE};
+    assert_int_equal(DATA_SIZE, sink_data(DATA_SIZE, &sink));
+    if(strategy != SINK_AUTO) assert_int_equal(strategy, sink.used);
+    assert_target_contents(DATA_SIZE);
+}
+
+/* resume part way through, as after a failed download */
+static void _test_offset(sink_strategy strategy)
+{
+    sink_t first = {.strategy = SINK_WRITE, .size = -1};
+    assert_int_equal(5000, sink_data(5000, &first));
+
+    sink_t rest = {
+        .strategy = strategy,
+        .offset = 5000,
+        .size = DATA_SIZE - 5000,
+    };
+    assert_int_equal(DATA_SIZE - 5000,
+                     sink_bytes(data + 5000, DATA_SIZE - 5000, &rest));
+    assert_target_contents(DATA_SIZE);
+}
+
+static void sink_auto(void **state)
+{
+    _test_strategy(SINK_AUTO);
+    _test_offset(SINK_AUTO);
+}
+
+static void sink_mmap(void **state)
+{
+    _test_strategy(SINK_MMAP);
+    _test_offset(SINK_MMAP);
+}
+
+static void sink_splice(void **state)
+{
+    _test_strategy(SINK_SPLICE);
+    _test_offset(SINK_SPLICE);
+}
+
+static void sink_direct(void **state)
+{
+    _test_strategy(SINK_DIRECT);
+    _test_offset(SINK_DIRECT);
+}
+
+static void sink_write(void **state)
+{
+    _test_strategy(SINK_WRITE);
+    _test_offset(SINK_WRITE);
+}
+
+static void sink_overwrite_shorter(void **state)
+{
+    sink_t sink = {.strategy = SINK_AUTO, .size = -1};
+    assert_int_equal(DATA_SIZE, sink_data(DATA_SIZE, &sink));
+    assert_int_equal(100, sink_data(100, &sink));
+    assert_target_contents(100);
+}
+
+static void sink_short_input(void **state)
+{
+    sink_t sink = {.strategy = SINK_WRITE, .size = DATA_SIZE};
+    assert_int_equal(100, sink_data(100, &sink));
+}
+
+static void sink_mmap_needs_size(void **state)
+{
+    sink_t sink = {.strategy = SINK_MMAP, .size = -1};
+    assert_int_equal(-1, sink_data(100, &sink));
+}
+
+static void sink_used_none(void **state)
+{
+    sink_t sink = {.strategy = SINK_WRITE, .size = -1};
+    assert_int_equal(-1, sink_copy(-1, "/nonexistent/target", &sink));
+    assert_int_equal(SINK_INVALID, sink.used);
+    assert_null(sink_strategy_name(sink.used));
+}
+
+static void count_progress(sink_t *sink, int64_t written)
+{
+    int64_t *last = sink->ctx;
+    assert_true(written > *last);
+    *last = written;
+}
+
+static void sink_progress(void **state)
+{
+    for(int i = SINK_MMAP; i < SINK_INVALID; i++) {
+        int64_t last = 0;
+        sink_t sink = {
+            .strategy = i,
+            .size = DATA_SIZE,
+            .progress = count_progress,
+            .ctx = &last,
+        };
+        assert_int_equal(DATA_SIZE, sink_data(DATA_SIZE, &sink));
+        assert_int_equal(DATA_SIZE, last);
+    }
+}
+
+/* a character device that is not device DAX is not mapped in auto mode */
+static void sink_auto_chardev(void **state)
+{
+    int pipefd[2];
+    assert_int_equal(0, pipe(pipefd));
+    assert_int_equal(4096, write(pipefd[1], data, 4096));
+    close(pipefd[1]);
+
+    sink_t sink = {.strategy = SINK_AUTO, .size = 4096};
+    assert_true(sink_copy(pipefd[0], "/dev/null", &sink) >= 0);
+    close(pipefd[0]);
+    assert_int_not_equal(SINK_MMAP, sink.used);
+}
+
+static void strategy_names(void **state)
+{
+    for(int i = 0; i < SINK_INVALID; i++) {
+        assert_int_equal(i, sink_strategy_from_name(sink_strategy_name(i)));
+    }
+    assert_int_equal(SINK_INVALID, sink_strategy_from_name("bogus"));
+    assert_int_equal(SINK_INVALID, sink_strategy_from_name(NULL));
+    assert_null(sink_strategy_name(SINK_INVALID));
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(sink_auto),
+        cmocka_unit_test(sink_auto_chardev),
+        cmocka_unit_test(sink_mmap),
+        cmocka_unit_test(sink_splice),
+        cmocka_unit_test(sink_direct),
+        cmocka_unit_test(sink_write),
+        cmocka_unit_test(sink_overwrite_shorter),
+        cmocka_unit_test(sink_short_input),
+        cmocka_unit_test(sink_mmap_needs_size),
+        cmocka_unit_test(sink_used_none),
+        cmocka_unit_test(sink_progress),
+        cmocka_unit_test(strategy_names),
+    };
+    return cmocka_run_group_tests(tests, setup, teardown);
+}
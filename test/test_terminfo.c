@@ -0,0 +1,69 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "common.h"
+#include "terminfo.h"
+
+static const uint8_t entry[] = "not really compiled terminfo";
+
+static void install_and_remove(void **state)
+{
+    unsetenv("TERMINFO");
+    char *dir = terminfo_install("linux-c", entry, sizeof(entry));
+    assert_non_null(dir);
+    assert_string_equal(dir, getenv("TERMINFO"));
+
+    char *path = saprintf("%s/l/linux-c", dir);
+    FILE *f = fopen(path, "rb");
+    assert_non_null(f);
+    uint8_t data[64] = {};
+    assert_int_equal(sizeof(entry), fread(data, 1, sizeof(data), f));
+    fclose(f);
+    assert_memory_equal(entry, data, sizeof(entry));
+
+    char *copy = strdup(dir);
+    terminfo_remove(dir, "linux-c");
+    struct stat st;
+    assert_int_equal(-1, stat(path, &st));
+    assert_int_equal(-1, stat(copy, &st));
+    free(copy);
+    free(path);
+}
+
+static void bad_names(void **state)
+{
+    unsetenv("TERMINFO");
+    assert_null(terminfo_install(NULL, entry, sizeof(entry)));
+    assert_null(terminfo_install("", entry, sizeof(entry)));
+    assert_null(terminfo_install("../linux-c", entry, sizeof(entry)));
+    assert_null(terminfo_install("linux-c", NULL, 0));
+    assert_null(getenv("TERMINFO"));
+    terminfo_remove(NULL, "linux-c");
+}
+
+static void unwritable(void **state)
+{
+    unsetenv("TERMINFO");
+    setenv("TMPDIR", "/nonexistent", 1);
+    assert_null(terminfo_install("linux-c", entry, sizeof(entry)));
+    assert_null(getenv("TERMINFO"));
+    unsetenv("TMPDIR");
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(install_and_remove),
+        cmocka_unit_test(bad_names),
+        cmocka_unit_test(unwritable),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,66 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "timing.h"
+
+static void timing_phases_written(void **state)
+{
+    char path[] = "/tmp/test_timing.XXXXXX";
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+
+    timing_start();
+    timing_phase("args");
+    timing_phase("load:%s", "a.json");
+    timing_report(path);
+
+    FILE *f = fopen(path, "r");
+    assert_non_null(f);
+    char name[64];
+    long long usec = -1;
+    assert_int_equal(2, fscanf(f, "%63s %lld", name, &usec));
+    assert_string_equal("args", name);
+    assert_true(usec >= 0);
+    assert_int_equal(2, fscanf(f, "%63s %lld", name, &usec));
+    assert_string_equal("load:a.json", name);
+    assert_int_equal(2, fscanf(f, "%63s %lld", name, &usec));
+    assert_string_equal("total", name);
+    assert_int_equal(timing_total_usec(), usec);
+    assert_int_equal(EOF, fscanf(f, "%63s", name));
+    fclose(f);
+    unlink(path);
+}
+
+static void timing_total_monotonic(void **state)
+{
+    timing_start();
+    timing_phase("a");
+    int64_t first = timing_total_usec();
+    usleep(1000);
+    timing_phase("b");
+    assert_true(timing_total_usec() >= first + 1000);
+}
+
+static void timing_report_no_path(void **state)
+{
+    timing_start();
+    timing_phase("a");
+    timing_report(NULL);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(timing_phases_written),
+        cmocka_unit_test(timing_total_monotonic),
+        cmocka_unit_test(timing_report_no_path),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include "timing.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syslog.h>
+#include <time.h>
+
+#define MAX_PHASES 64
+#define MAX_PHASE_NAME 64
+
+typedef struct _phase_t
+{
+    char name[MAX_PHASE_NAME];
+    int64_t usec;
+} phase_t;
+
+static phase_t phases[MAX_PHASES];
+static int num_phases;
+static struct timespec start;
+static struct timespec last;
+
+static int64_t usec_between(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1000000
+        + (b->tv_nsec - a->tv_nsec) / 1000;
+}
+
+void timing_start(void)
+{
+    num_phases = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    last = start;
+}
+
+void timing_phase(const char *fmt, ...)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    /* past the limit, later phases are folded into the last slot */
+    phase_t *phase = &phases[num_phases < MAX_PHASES ?
+                             num_phases++ : MAX_PHASES - 1];
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(phase->name, sizeof(phase->name), fmt, ap);
+    va_end(ap);
+
+    phase->usec = usec_between(&last, &now);
+    last = now;
+}
+
+int64_t timing_total_usec(void)
+{
+    return usec_between(&start, &last);
+}
+
+void timing_report(const char *path)
+{
+    char *record = saprintf("total=%" PRId64, timing_total_usec());
+    for(int i = 0; record && i < num_phases; i++) {
+        char *next = saprintf("%s %s=%" PRId64,
+                              record, phases[i].name, phases[i].usec);
+        free(record);
+        record = next;
+    }
+    if(record) {
+        syslog(LOG_INFO, "timing usec: %s", record);
+        free(record);
+    }
+
+    if(!path) return;
+
+    FILE *f = fopen(path, "w");
+    if(!f) {
+        syslog(LOG_ERR, "failed to open timing file [%s]: %m", path);
+        return;
+    }
+    for(int i = 0; i < num_phases; i++) {
+        fprintf(f, "%s %" PRId64 "\n", phases[i].name, phases[i].usec);
+    }
+    fprintf(f, "total %" PRId64 "\n", timing_total_usec());
+    fclose(f);
+}
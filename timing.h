@@ -0,0 +1,32 @@
+/*
+ * Copyright 2022-2023 Canonical Ltd.
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/* Phases are measured on the monotonic clock.  Each call to timing_phase()
+ * closes the phase which began at the previous call, or at timing_start(). */
+void timing_start(void);
+void timing_phase(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int64_t timing_total_usec(void);
+
+/* Emit the recorded phases as a single syslog record, and if path is not
+ * NULL, also to that file as one "<phase> <usec>" line per phase. */
+void timing_report(const char *path);